@@ -14,158 +14,118 @@
 //
 //@HEADER
 
-#include "generate_matrix.hpp"
-#include "Kokkos_Graph.hpp"
-
-using vector_t = Kokkos::View<double *>;
-using scalar_t = Kokkos::View<double, Kokkos::CudaUVMSpace>;
+// CG solve with the iteration captured once as a stdexx::graph and
+// replayed every iteration, ported from the Kokkos Graph version.
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <vector>
+
+#include <stdexx.hpp>
+
+#include "crs_matrix.hpp"
+
+#if (STDEXX_QTHREADS)
+
+using vector_t = std::vector<double>;
+
+// Scalars of the solve. The graph nodes only hold pointers to these, so
+// every replay picks up whatever the previous one left in them.
+struct cg_scalars {
+  double rtrans = 0;
+  double oldrtrans = 0;
+  double alpha = 0;
+  double beta = 0;
+  double p_ap_dot = 0;
+};
 
 struct SPMV {
-  vector_t y;
-  CrsMatrix<typename Kokkos::DefaultExecutionSpace::memory_space> A;
-  vector_t x;
-  int rows_per_team;
-  int64_t nrows;
-
-  SPMV(vector_t &y_,
-       CrsMatrix<typename Kokkos::DefaultExecutionSpace::memory_space> &A_,
-       vector_t &x_,
-       int rows_per_team_):
-    y(y_), A(A_), x(x_), rows_per_team(rows_per_team_), nrows(y.extent(0)) {}
-
-  KOKKOS_FUNCTION
-  void operator()(Kokkos::TeamPolicy<>::member_type const &team) const {
-    int64_t const first_row = team.league_rank() * rows_per_team;
-    int64_t const last_row =
-      first_row + rows_per_team < nrows ? first_row + rows_per_team : nrows;
-    Kokkos::parallel_for(
-      Kokkos::TeamThreadRange(team, first_row, last_row),
-      [&](int64_t const row) {
-        int64_t const row_start = A.row_ptr(row);
-        int64_t const row_length = A.row_ptr(row + 1) - row_start;
-
-        double y_row;
-        Kokkos::parallel_reduce(
-          Kokkos::ThreadVectorRange(team, row_length),
-          [=](int64_t const i, double &sum) {
-            sum += A.values(i + row_start) * x(A.col_idx(i + row_start));
-          },
-          y_row);
-        y(row) = y_row;
-      });
+  double *y;
+  INT_TYPE const *row_ptr;
+  INT_TYPE const *col_idx;
+  double const *values;
+  double const *x;
+
+  SPMV(vector_t &y_, crs_matrix const &A, vector_t const &x_):
+    y(y_.data()), row_ptr(A.row_ptr.data()), col_idx(A.col_idx.data()),
+    values(A.values.data()), x(x_.data()) {}
+
+  void operator()(INT_TYPE row) const {
+    INT_TYPE const row_start = row_ptr[row];
+    INT_TYPE const row_end = row_ptr[row + 1];
+    double y_row = 0;
+    for (INT_TYPE i = row_start; i < row_end; ++i) {
+      y_row += values[i] * x[col_idx[i]];
+    }
+    y[row] = y_row;
   }
 };
 
-template <class YType, class AType, class XType>
-void spmv(YType y, AType A, XType x) {
-  // For low thread counts spread rows over individual threads
-  int rows_per_team = 512;
-  int team_size = 1;
-
-  // For high concurrency architecture use teams
-  if (Kokkos::DefaultExecutionSpace().concurrency() > 1024) {
-    rows_per_team = 16;
-    team_size = 16;
-  }
-
-  int64_t nrows = y.extent(0);
-  Kokkos::parallel_for(
-    "SPMV",
-    Kokkos::TeamPolicy<>(
-      (nrows + rows_per_team - 1) / rows_per_team, team_size, 8),
-    KOKKOS_LAMBDA(Kokkos::TeamPolicy<>::member_type const &team) {
-      int64_t const first_row = team.league_rank() * rows_per_team;
-      int64_t const last_row =
-        first_row + rows_per_team < nrows ? first_row + rows_per_team : nrows;
-      Kokkos::parallel_for(
-        Kokkos::TeamThreadRange(team, first_row, last_row),
-        [&](int64_t const row) {
-          int64_t const row_start = A.row_ptr(row);
-          int64_t const row_length = A.row_ptr(row + 1) - row_start;
-
-          double y_row;
-          Kokkos::parallel_reduce(
-            Kokkos::ThreadVectorRange(team, row_length),
-            [=](int64_t const i, double &sum) {
-              sum += A.values(i + row_start) * x(A.col_idx(i + row_start));
-            },
-            y_row);
-          y(row) = y_row;
-        });
-    });
-}
-
 struct Dot {
-  vector_t x, y;
-  scalar_t alpha, oldrtrans;
-  Kokkos::View<double, Kokkos::CudaHostPinnedSpace> rtrans;
+  double const *x;
+  double const *y;
+  double *alpha;
+  double *rtrans;
+  double *oldrtrans;
   int invert;
 
-  Dot(vector_t &x_,
-      vector_t &y_,
-      scalar_t &alpha_,
-      Kokkos::View<double, Kokkos::CudaHostPinnedSpace> &rtrans_,
-      scalar_t &oldrtrans_,
+  Dot(vector_t const &x_,
+      vector_t const &y_,
+      double &alpha_,
+      double &rtrans_,
+      double &oldrtrans_,
       int invert_):
-    x(x_), y(y_), alpha(alpha_), rtrans(rtrans_), oldrtrans(oldrtrans_),
-    invert(invert_) {}
+    x(x_.data()), y(y_.data()), alpha(&alpha_), rtrans(&rtrans_),
+    oldrtrans(&oldrtrans_), invert(invert_) {}
 
-  KOKKOS_FUNCTION
-  void operator()(int64_t const &i, double &lsum) const { lsum += y(i) * x(i); }
+  void operator()(INT_TYPE i, double &lsum) const { lsum += y[i] * x[i]; }
 
-  KOKKOS_FUNCTION
-  void final(double &result) const {
+  void final(double result) const {
     if (invert) {
-      alpha() = rtrans() / result;
-      oldrtrans() = result;
+      *alpha = *rtrans / result;
+      *oldrtrans = result;
     } else {
-      oldrtrans() = rtrans();
-      alpha() = result / oldrtrans();
-      rtrans() = result;
+      *oldrtrans = *rtrans;
+      *alpha = result / *oldrtrans;
+      *rtrans = result;
     }
   }
 };
 
-template <class YType, class XType>
-double dot(YType y, XType x) {
-  double result;
-  Kokkos::parallel_reduce(
-    "DOT",
-    y.extent(0),
-    KOKKOS_LAMBDA(int64_t const &i, double &lsum) { lsum += y(i) * x(i); },
-    result);
-  return result;
-}
-
 struct AXPBY {
-  vector_t z, x, y;
-  scalar_t beta;
-  double alpha, scale;
-
-  AXPBY(
-    vector_t &z_, double a, vector_t &x_, double s, scalar_t &b, vector_t &y_):
-    z(z_), alpha(a), x(x_), scale(s), beta(b), y(y_) {}
-
-  KOKKOS_FUNCTION
-  void operator()(int const &i) const {
-    z(i) = alpha * x(i) + scale * beta() * y(i);
+  double *z;
+  double alpha;
+  double const *x;
+  double scale;
+  double const *beta;
+  double const *y;
+
+  AXPBY(vector_t &z_,
+        double a,
+        vector_t const &x_,
+        double s,
+        double const &b,
+        vector_t const &y_):
+    z(z_.data()), alpha(a), x(x_.data()), scale(s), beta(&b), y(y_.data()) {}
+
+  void operator()(INT_TYPE i) const {
+    z[i] = alpha * x[i] + scale * *beta * y[i];
   }
 };
 
-template <class ZType, class YType, class XType>
-void axpby(
-  ZType z, double alpha, XType x, double scale, scalar_t beta, YType y) {
-  int64_t n = z.extent(0);
-  Kokkos::parallel_for(
-    "AXPBY", n, KOKKOS_LAMBDA(int const &i) {
-      z(i) = alpha * x(i) + scale * beta() * y(i);
-    });
+// Reduction node for one of the Dot functors above.
+stdexx::graph_node then_dot(stdexx::graph_node node, INT_TYPE n, Dot dot) {
+  return node.then_reduce(
+    n, 0.0, dot, [dot](double result) { dot.final(result); });
 }
 
-template <class VType, class AType>
-int cg_solve(VType y,
-             AType A,
-             VType b,
+int cg_solve(crs_matrix const &A,
+             vector_t const &b,
              int max_iter,
              double tolerance,
              int64_t print_freq) {
@@ -173,26 +133,51 @@ int cg_solve(VType y,
   int num_iters = 0;
 
   double normr = 0;
-  Kokkos::View<double, Kokkos::CudaHostPinnedSpace> rtrans("RTrants");
-  scalar_t alpha("Alpha");
-  scalar_t beta("Alpha");
-  scalar_t p_ap_dot("p_Ap_dot");
-  scalar_t oldrtrans("OldTrans");
-
-  VType x("x", b.extent(0));
-  VType r("r", x.extent(0));
-  VType p("r", x.extent(0));
-  VType Ap("r", x.extent(0));
+  cg_scalars s;
+
+  INT_TYPE n = b.size();
+  vector_t x(n);
+  vector_t r(n);
+  vector_t p(n);
+  vector_t Ap(n);
   double one = 1.0;
   double zero = 0.0;
 
-  alpha() = 1.;
-  axpby(p, one, x, zero, alpha, x);
-  spmv(Ap, A, p);
-  axpby(r, one, b, -one, alpha, Ap);
-
-  rtrans() = dot(r, r);
-  normr = std::sqrt(rtrans());
+  // Each graph is captured once. The first two only run once, they're
+  // graphs too so the whole solve goes through the same kernels.
+  auto setup = stdexx::create_graph([&](stdexx::graph_node root) {
+    root.then_bulk(n, AXPBY(p, one, x, zero, s.alpha, x))
+      .then_bulk(n, SPMV(Ap, A, p))
+      .then_bulk(n, AXPBY(r, one, b, -one, s.alpha, Ap))
+      .then_reduce(n,
+                   0.0,
+                   Dot(r, r, s.alpha, s.rtrans, s.oldrtrans, 0),
+                   [&s](double result) { s.rtrans = result; });
+  });
+  auto first = stdexx::create_graph([&](stdexx::graph_node root) {
+    auto spmvn = root.then_bulk(n, AXPBY(p, one, r, zero, s.beta, r))
+                   .then_bulk(n, SPMV(Ap, A, p));
+    then_dot(spmvn, n, Dot(Ap, p, s.alpha, s.rtrans, s.p_ap_dot, 1));
+  });
+  auto update = stdexx::create_graph([&](stdexx::graph_node root) {
+    root.then_bulk(n, AXPBY(x, one, x, one, s.alpha, p))
+      .then_bulk(n, AXPBY(r, one, r, -one, s.alpha, Ap));
+  });
+  auto iteration = stdexx::create_graph([&](stdexx::graph_node root) {
+    auto dot1 = then_dot(root, n, Dot(r, r, s.alpha, s.rtrans, s.oldrtrans, 0));
+    auto axpby1 = dot1.then_bulk(n, AXPBY(p, one, r, one, s.alpha, p));
+    auto spmvn = axpby1.then_bulk(n, SPMV(Ap, A, p));
+    auto dot2 =
+      then_dot(spmvn, n, Dot(Ap, p, s.alpha, s.rtrans, s.p_ap_dot, 1));
+    // Same as in the Kokkos version, a linear graph is a bit faster than
+    // exposing the concurrency of the two updates.
+    dot2.then_bulk(n, AXPBY(x, one, x, one, s.alpha, p))
+      .then_bulk(n, AXPBY(r, one, r, -one, s.alpha, Ap));
+  });
+
+  s.alpha = 1.;
+  stdexec::sync_wait(setup.submit());
+  normr = std::sqrt(s.rtrans);
 
   if (myproc == 0) { std::cout << "Initial Residual = " << normr << std::endl; }
 
@@ -200,99 +185,38 @@ int cg_solve(VType y,
   // Do iteration k == 1
   {
     int k = 1;
-    axpby(p, one, r, zero, beta, r);
-    spmv(Ap, A, p);
-    Kokkos::parallel_reduce(
-      "Dot2", Ap.extent(0), Dot(Ap, p, alpha, rtrans, p_ap_dot, 1));
+    stdexec::sync_wait(first.submit());
 
     if (myproc == 0 && (k % print_freq == 0 || k == max_iter)) {
-      normr = std::sqrt(rtrans());
+      normr = std::sqrt(s.rtrans);
       std::cout << "Iteration = " << k << "   Residual = " << normr
                 << std::endl;
     }
-    if (p_ap_dot() < brkdown_tol) {
-      if (p_ap_dot() < 0) {
+    if (s.p_ap_dot < brkdown_tol) {
+      if (s.p_ap_dot < 0) {
         std::cerr << "miniFE::cg_solve ERROR, numerical breakdown!"
                   << std::endl;
         return num_iters;
-      } else brkdown_tol = 0.1 * p_ap_dot();
+      } else brkdown_tol = 0.1 * s.p_ap_dot;
     }
 
-    axpby(x, one, x, one, alpha, p);
-    axpby(r, one, r, -one, alpha, Ap);
+    stdexec::sync_wait(update.submit());
     num_iters = k;
   }
 
-  int rows_per_team = 512;
-  int team_size = 1;
-
-  // For high concurrency architecture use teams
-  if (Kokkos::DefaultExecutionSpace().concurrency() > 1024) {
-    rows_per_team = 16;
-    team_size = 16;
-  }
-  int64_t nrows = y.extent(0);
-  // #define USE_GRAPH
-#ifdef USE_GRAPH
-  auto graph = Kokkos::Experimental::create_graph(
-    Kokkos::DefaultExecutionSpace(), [&](auto root) {
-      auto dot1 = root.then_parallel_reduce(
-        "Dot1", r.extent(0), Dot(r, r, alpha, rtrans, oldrtrans, 0), rtrans);
-      auto axpby1 = dot1.then_parallel_for(
-        "AXPBY", r.extent(0), AXPBY(p, one, r, one, alpha, p));
-      auto spmvn = axpby1.then_parallel_for(
-        "SPMV",
-        Kokkos::TeamPolicy<>(
-          (nrows + rows_per_team - 1) / rows_per_team, team_size, 8),
-        SPMV(Ap, A, p, rows_per_team));
-      auto dot2 = spmvn.then_parallel_reduce(
-        "Dot2", Ap.extent(0), Dot(Ap, p, alpha, rtrans, p_ap_dot, 1), p_ap_dot);
-      auto axpby2 = dot2.then_parallel_for(
-        "AXPBY", x.extent(0), AXPBY(x, one, x, one, alpha, p));
-// For some reason its a bit slower if one actually exposes the available
-// concurrency Simple linear graph executes a bit faster
-#if 0
-    dot2.then_parallel_for("AXPBY",r.extent(0),AXPBY(r, one, r, -one, alpha, Ap));
-#else
-      axpby2.then_parallel_for(
-        "AXPBY", r.extent(0), AXPBY(r, one, r, -one, alpha, Ap));
-#endif
-    });
-#endif
-
   for (int64_t k = 2; k <= max_iter && normr > tolerance; ++k) {
-#ifndef USE_GRAPH
-    Kokkos::parallel_reduce(
-      "Dot1", r.extent(0), Dot(r, r, alpha, rtrans, oldrtrans, 0), rtrans);
-    Kokkos::parallel_for("AXPBY", r.extent(0), AXPBY(p, one, r, one, alpha, p));
-    Kokkos::parallel_for(
-      "SPMV",
-      Kokkos::TeamPolicy<>(
-        (nrows + rows_per_team - 1) / rows_per_team, team_size, 8),
-      SPMV(Ap, A, p, rows_per_team));
-    Kokkos::parallel_reduce(
-      "Dot2", Ap.extent(0), Dot(Ap, p, alpha, rtrans, p_ap_dot, 1), p_ap_dot);
-    Kokkos::parallel_for("AXPBY", x.extent(0), AXPBY(x, one, x, one, alpha, p));
-    Kokkos::parallel_for(
-      "AXPBY", r.extent(0), AXPBY(r, one, r, -one, alpha, Ap));
-#else
-    graph.submit();
-#endif
+    stdexec::sync_wait(iteration.submit());
+    normr = std::sqrt(s.rtrans);
     if (myproc == 0 && (k % print_freq == 0 || k == max_iter)) {
-      Kokkos::fence();
-      normr = std::sqrt(rtrans());
       std::cout << "Iteration = " << k << "   Residual = " << normr
                 << std::endl;
-      if (p_ap_dot() < brkdown_tol) {
-        if (p_ap_dot() < 0) {
+      if (s.p_ap_dot < brkdown_tol) {
+        if (s.p_ap_dot < 0) {
           std::cerr << "miniFE::cg_solve ERROR, numerical breakdown!"
                     << std::endl;
           return num_iters;
-        } else brkdown_tol = 0.1 * p_ap_dot();
+        } else brkdown_tol = 0.1 * s.p_ap_dot;
       }
-    } else {
-      Kokkos::fence();
-      normr = std::sqrt(rtrans());
     }
     num_iters = k;
   }
@@ -300,7 +224,7 @@ int cg_solve(VType y,
 }
 
 int main(int argc, char *argv[]) {
-  Kokkos::ScopeGuard guard(argc, argv);
+  stdexx::runtime rt;
 
   int N = argc > 1 ? atoi(argv[1]) : 100;
   int max_iter = argc > 2 ? atoi(argv[2]) : 200;
@@ -308,39 +232,26 @@ int main(int argc, char *argv[]) {
   int64_t print_freq = argc > 4 ? atoi(argv[4]) : max_iter / 10;
   if (print_freq < 1) print_freq = 1;
 
-  CrsMatrix<Kokkos::HostSpace> h_A = Impl::generate_miniFE_matrix(N);
-  Kokkos::View<double *, Kokkos::HostSpace> h_x =
-    Impl::generate_miniFE_vector(N);
-
-  Kokkos::View<int64_t *> row_ptr("row_ptr", h_A.row_ptr.extent(0));
-  Kokkos::View<int64_t *> col_idx("col_idx", h_A.col_idx.extent(0));
-  Kokkos::View<double *> values("values", h_A.values.extent(0));
-
-  CrsMatrix<Kokkos::DefaultExecutionSpace::memory_space> A(
-    row_ptr, col_idx, values, h_A.num_cols());
-  Kokkos::View<double *> x("X", h_x.extent(0));
-  Kokkos::View<double *> y("Y", h_x.extent(0));
+  crs_matrix A = Impl::generate_miniFE_crs(rt.get_scheduler(), N);
+  vector_t b = Impl::generate_miniFE_rhs(N);
 
-  Kokkos::deep_copy(x, h_x);
-  Kokkos::deep_copy(A.row_ptr, h_A.row_ptr);
-  Kokkos::deep_copy(A.col_idx, h_A.col_idx);
-  Kokkos::deep_copy(A.values, h_A.values);
-
-  Kokkos::Timer timer;
-  int num_iters = cg_solve(y, A, x, max_iter, tolerance, print_freq);
-  double time = timer.seconds();
+  auto start = std::chrono::steady_clock::now();
+  int num_iters = cg_solve(A, b, max_iter, tolerance, print_freq);
+  double time =
+    std::chrono::duration<double>(std::chrono::steady_clock::now() - start)
+      .count();
 
   // Compute Bytes and Flops
-  double spmv_bytes = A.num_rows() * sizeof(int64_t) +
-                      A.nnz() * sizeof(int64_t) + A.nnz() * sizeof(double) +
+  double spmv_bytes = A.num_rows() * sizeof(INT_TYPE) +
+                      A.nnz() * sizeof(INT_TYPE) + A.nnz() * sizeof(double) +
                       A.nnz() * sizeof(double) + A.num_rows() * sizeof(double);
 
-  double dot_bytes = x.extent(0) * sizeof(double) * 2;
-  double axpby_bytes = x.extent(0) * sizeof(double) * 3;
+  double dot_bytes = b.size() * sizeof(double) * 2;
+  double axpby_bytes = b.size() * sizeof(double) * 3;
 
   double spmv_flops = A.nnz() * 2;
-  double dot_flops = x.extent(0) * 2;
-  double axpby_flops = x.extent(0) * 3;
+  double dot_flops = b.size() * 2;
+  double axpby_flops = b.size() * 3;
 
   int spmv_calls = 1 + num_iters;
   int dot_calls = num_iters;
@@ -366,3 +277,15 @@ int main(int argc, char *argv[]) {
     dot_calls,
     axpby_calls);
 }
+
+#elif (STDEXX_ARGOBOTS)
+
+auto main() -> int {} // todo
+
+#elif (STDEXX_REFERENCE)
+
+auto main() -> int {}
+
+#else
+error "Not implemented."
+#endif
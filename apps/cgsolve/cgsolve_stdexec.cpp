@@ -14,147 +14,129 @@
 //
 //@HEADER
 
-#include "generate_matrix.hpp"
-#ifdef USE_MKL
-#include <mkl.h>
-#endif
-
-// We map to KokkosKernels to get access to third party libraries
-#ifdef USE_KOKKOS_KERNELS
-#include <KokkosBlas.hpp>
-#include <KokkosSparse_spmv.hpp>
-
-template <class YType, class AType, class XType>
-void spmv(YType y, AType A, XType x) {
-  KokkosSparse::CrsMatrix<
-    double,
-    INT_TYPE,
-    Kokkos::Device<Kokkos::DefaultExecutionSpace,
-                   typename Kokkos::DefaultExecutionSpace::memory_space>,
-    void,
-    INT_TYPE>
-    matrix("A",          // const std::string& /* label */,
-           A.num_rows(), // const OrdinalType nrows,
-           A.num_cols(), // const OrdinalType ncols,
-           A.nnz(),      // const size_type annz,
-           A.values,     // const values_type& vals,
-           A.row_ptr,    // const row_map_type& rowmap,
-           A.col_idx);   // const index_type& cols)
-  KokkosSparse::spmv("N", 1.0, matrix, x, 0.0, y);
-}
-
-#if 0
-template <class YType, class XType>
-double dot(YType y, XType x) {
-  return KokkosBlas::dot(y,x);
+// CG solve with spmv, dot and axpby as bulk senders on the qthreads
+// scheduler. Each CG iteration is a single sender chain, with the
+// element-wise stages fused into as few passes as possible.
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+#include <stdexx.hpp>
+
+#include "crs_matrix.hpp"
+
+#if (STDEXX_QTHREADS)
+
+using vector_t = std::vector<double>;
+
+// Row kernel of y = A * x.
+auto spmv_row(vector_t &y, crs_matrix const &A, vector_t const &x) {
+  double *y_ = y.data();
+  INT_TYPE const *row_ptr = A.row_ptr.data();
+  INT_TYPE const *col_idx = A.col_idx.data();
+  double const *values = A.values.data();
+  double const *x_ = x.data();
+  return [=](INT_TYPE row) {
+    INT_TYPE const row_start = row_ptr[row];
+    INT_TYPE const row_end = row_ptr[row + 1];
+    double y_row = 0;
+    for (INT_TYPE i = row_start; i < row_end; ++i) {
+      y_row += values[i] * x_[col_idx[i]];
+    }
+    y_[row] = y_row;
+  };
 }
 
-template <class ZType, class YType, class XType>
-void axpby(ZType z, double alpha, XType x, double beta, YType y) {
-  if(z.data() == y.data())
-    return KokkosBlas::axpby(alpha,x,beta,y);
-  else
-    return KokkosBlas::update(alpha,x,beta,y,0.,z);
+// y = A * x, one row per index.
+auto spmv(vector_t &y, crs_matrix const &A, vector_t const &x) {
+  return stdexec::bulk(stdexec::par, A.num_rows(), spmv_row(y, A, x));
 }
-#endif
-
-#else
-template <class YType, class AType, class XType>
-void spmv(YType y, AType A, XType x) {
-  int num_rows = A.num_rows();
-#ifdef USE_MKL
-  mkl_dcsrgemv("N",
-               &num_rows,
-               A.values.data(),
-               A.row_ptr.data(),
-               A.col_idx.data(),
-               x.data(),
-               y.data());
-#else
 
-  // For low thread counts spread rows over individual threads
-  int rows_per_team = 512;
-  int team_size = 1;
-
-  // For high concurrency architecture use teams
-  if (Kokkos::DefaultExecutionSpace().concurrency() > 1024) {
-    rows_per_team = 16;
-    team_size = 16;
-  }
-
-  INT_TYPE nrows = y.extent(0);
-  Kokkos::parallel_for(
-    "SPMV",
-    Kokkos::TeamPolicy<>(
-      (nrows + rows_per_team - 1) / rows_per_team, team_size, 8),
-    KOKKOS_LAMBDA(Kokkos::TeamPolicy<>::member_type const &team) {
-      const INT_TYPE first_row = team.league_rank() * rows_per_team;
-      const INT_TYPE last_row =
-        first_row + rows_per_team < nrows ? first_row + rows_per_team : nrows;
-      Kokkos::parallel_for(
-        Kokkos::TeamThreadRange(team, first_row, last_row),
-        [&](const INT_TYPE row) {
-          const INT_TYPE row_start = A.row_ptr(row);
-          const INT_TYPE row_length = A.row_ptr(row + 1) - row_start;
-
-          double y_row;
-          Kokkos::parallel_reduce(
-            Kokkos::ThreadVectorRange(team, row_length),
-            [=](const INT_TYPE i, double &sum) {
-              sum += A.values(i + row_start) * x(A.col_idx(i + row_start));
-            },
-            y_row);
-          y(row) = y_row;
-        });
-    });
-#endif
+// Term i of y . x, for folding a dot product into a fused traversal.
+auto dot_term(vector_t const &y, vector_t const &x) {
+  double const *y_ = y.data();
+  double const *x_ = x.data();
+  return [=](std::size_t i, double &acc) { acc += y_[i] * x_[i]; };
 }
-#endif
 
-template <class YType, class XType>
-double dot(YType y, XType x) {
-  double result;
-  Kokkos::parallel_reduce(
-    "DOT",
-    y.extent(0),
-    KOKKOS_LAMBDA(const INT_TYPE &i, double &lsum) { lsum += y(i) * x(i); },
-    result);
-  return result;
+// Element kernel of z = alpha * x + scale * beta * y. beta is read
+// when the stage runs, so it can be computed by an earlier stage of the
+// same chain.
+auto axpby_at(vector_t &z,
+              double alpha,
+              vector_t const &x,
+              double scale,
+              double const &beta,
+              vector_t const &y) {
+  double *z_ = z.data();
+  double const *x_ = x.data();
+  double const *y_ = y.data();
+  double const *beta_ = &beta;
+  return [=](std::size_t i) { z_[i] = alpha * x_[i] + scale * *beta_ * y_[i]; };
 }
 
-template <class ZType, class YType, class XType>
-void axpby(ZType z, double alpha, XType x, double beta, YType y) {
-  INT_TYPE n = z.extent(0);
-  Kokkos::parallel_for(
-    "AXPBY", n, KOKKOS_LAMBDA(int const &i) {
-      z(i) = alpha * x(i) + beta * y(i);
+// Same as a bulk stage of its own. It's handed whole chunks so that the
+// inner loop can be vectorized.
+auto axpby(vector_t &z,
+           double alpha,
+           vector_t const &x,
+           double scale,
+           double const &beta,
+           vector_t const &y) {
+  double *z_ = z.data();
+  double const *x_ = x.data();
+  double const *y_ = y.data();
+  double const *beta_ = &beta;
+  return stdexx::bulk_chunked(
+    z.size(), [=](std::size_t begin, std::size_t end) {
+      double const b = scale * *beta_;
+      for (std::size_t i = begin; i < end; ++i) {
+        z_[i] = alpha * x_[i] + b * y_[i];
+      }
     });
 }
 
-template <class VType, class AType>
-int cg_solve(VType y, AType A, VType b, int max_iter, double tolerance) {
+template <class Scheduler>
+int cg_solve(Scheduler sched,
+             crs_matrix const &A,
+             vector_t const &b,
+             int max_iter,
+             double tolerance) {
   int myproc = 0;
   int num_iters = 0;
 
   double normr = 0;
   double rtrans = 0;
   double oldrtrans = 0;
+  double alpha = 0;
+  double beta = 0;
+  double p_ap_dot = 0;
 
   INT_TYPE print_freq = max_iter / 10;
   if (print_freq > 50) print_freq = 50;
   if (print_freq < 1) print_freq = 1;
-  VType x("x", b.extent(0));
-  VType r("r", x.extent(0));
-  VType p("r", x.extent(0));
-  VType Ap("r", x.extent(0));
+  vector_t x(b.size());
+  vector_t r(x.size());
+  vector_t p(x.size());
+  vector_t Ap(x.size());
   double one = 1.0;
   double zero = 0.0;
 
-  axpby(p, one, x, zero, x);
-  spmv(Ap, A, p);
-  axpby(r, one, b, -one, Ap);
-
-  rtrans = dot(r, r);
+  INT_TYPE n = x.size();
+  auto [rr] =
+    stdexec::sync_wait(stdexec::schedule(sched) |
+                       axpby(p, one, x, zero, zero, x) |
+                       spmv(Ap, A, p) |
+                       stdexx::fused_bulk(n, axpby_at(r, one, b, -one, one, Ap))
+                         .then_reduce(0.0, dot_term(r, r)))
+      .value();
+  rtrans = rr;
 
   normr = std::sqrt(rtrans);
 
@@ -162,14 +144,43 @@ int cg_solve(VType y, AType A, VType b, int max_iter, double tolerance) {
 
   double brkdown_tol = std::numeric_limits<double>::epsilon();
 
-  for (INT_TYPE k = 1; k <= max_iter && normr > tolerance; ++k) {
-    if (k == 1) {
-      axpby(p, one, r, zero, r);
-    } else {
+  // Every iteration is one chain of three passes over the vectors
+  // instead of six. spmv only reads p, so the Ap . p dot product can be
+  // folded into it. The x and r updates are element-wise and so is the
+  // r . r of the next iteration. beta starts out at zero, which makes
+  // the first update of p a copy of r.
+  // A breakdown is thrown out of the chain and comes back out of
+  // sync_wait.
+  auto iteration =
+    axpby(p, one, r, one, beta, p) |
+    stdexx::fused_bulk(n, spmv_row(Ap, A, p))
+      .then_reduce(0.0, dot_term(Ap, p)) |
+    stdexec::then([&](double result) {
+      p_ap_dot = result;
+      if (p_ap_dot < brkdown_tol) {
+        if (p_ap_dot < 0) {
+          throw std::runtime_error(
+            "miniFE::cg_solve ERROR, numerical breakdown!");
+        } else brkdown_tol = 0.1 * p_ap_dot;
+      }
+      alpha = rtrans / p_ap_dot;
+    }) |
+    stdexx::fused_bulk(n,
+                       axpby_at(x, one, x, one, alpha, p),
+                       axpby_at(r, one, r, -one, alpha, Ap))
+      .then_reduce(0.0, dot_term(r, r)) |
+    stdexec::then([&](double result) {
       oldrtrans = rtrans;
-      rtrans = dot(r, r);
-      double beta = rtrans / oldrtrans;
-      axpby(p, one, r, beta, p);
+      rtrans = result;
+      beta = rtrans / oldrtrans;
+    });
+
+  for (INT_TYPE k = 1; k <= max_iter && normr > tolerance; ++k) {
+    try {
+      stdexec::sync_wait(stdexec::schedule(sched) | iteration);
+    } catch (std::runtime_error const &e) {
+      std::cerr << e.what() << std::endl;
+      return num_iters;
     }
 
     normr = std::sqrt(rtrans);
@@ -178,78 +189,47 @@ int cg_solve(VType y, AType A, VType b, int max_iter, double tolerance) {
       std::cout << "Iteration = " << k << "   Residual = " << normr
                 << std::endl;
     }
-
-    double alpha = 0;
-    double p_ap_dot = 0;
-
-    spmv(Ap, A, p);
-
-    p_ap_dot = dot(Ap, p);
-
-    if (p_ap_dot < brkdown_tol) {
-      if (p_ap_dot < 0) {
-        std::cerr << "miniFE::cg_solve ERROR, numerical breakdown!"
-                  << std::endl;
-        return num_iters;
-      } else brkdown_tol = 0.1 * p_ap_dot;
-    }
-    alpha = rtrans / p_ap_dot;
-
-    axpby(x, one, x, alpha, p);
-    axpby(r, one, r, -alpha, Ap);
     num_iters = k;
   }
   return num_iters;
 }
 
 int main(int argc, char *argv[]) {
-  Kokkos::ScopeGuard guard(argc, argv);
+  stdexx::runtime rt;
+  auto sched = rt.get_scheduler();
 
   int N = argc > 1 ? atoi(argv[1]) : 100;
   int max_iter = argc > 2 ? atoi(argv[2]) : 200;
   double tolerance = argc > 3 ? atoi(argv[3]) : 0;
 
-  CrsMatrix<Kokkos::HostSpace> h_A = Impl::generate_miniFE_matrix(N);
-  Kokkos::View<double *, Kokkos::HostSpace> h_x =
-    Impl::generate_miniFE_vector(N);
-
-  Kokkos::View<INT_TYPE *> row_ptr("row_ptr", h_A.row_ptr.extent(0));
-  Kokkos::View<INT_TYPE *> col_idx("col_idx", h_A.col_idx.extent(0));
-  Kokkos::View<double *> values("values", h_A.values.extent(0));
+  crs_matrix A = Impl::generate_miniFE_crs(sched, N);
+  vector_t b = Impl::generate_miniFE_rhs(N);
 
-  CrsMatrix<Kokkos::DefaultExecutionSpace::memory_space> A(
-    row_ptr, col_idx, values, h_A.num_cols());
-  Kokkos::View<double *> x("X", h_x.extent(0));
-  Kokkos::View<double *> y("Y", h_x.extent(0));
-
-  Kokkos::deep_copy(x, h_x);
-  Kokkos::deep_copy(A.row_ptr, h_A.row_ptr);
-  Kokkos::deep_copy(A.col_idx, h_A.col_idx);
-  Kokkos::deep_copy(A.values, h_A.values);
   std::cout << "============" << std::endl;
   std::cout << "WarmUp Solve" << std::endl;
   std::cout << "============" << std::endl << std::endl;
-  int num_iters = cg_solve(y, A, x, 20, tolerance);
+  int num_iters = cg_solve(sched, A, b, 20, tolerance);
 
-  Kokkos::deep_copy(x, h_x);
   std::cout << std::endl << "============" << std::endl;
   std::cout << "Timing Solve" << std::endl;
   std::cout << "============" << std::endl << std::endl;
-  Kokkos::Timer timer;
-  num_iters = cg_solve(y, A, x, max_iter, tolerance);
-  double time = timer.seconds();
+  auto start = std::chrono::steady_clock::now();
+  num_iters = cg_solve(sched, A, b, max_iter, tolerance);
+  double time =
+    std::chrono::duration<double>(std::chrono::steady_clock::now() - start)
+      .count();
 
   // Compute Bytes and Flops
   double spmv_bytes = A.num_rows() * sizeof(INT_TYPE) +
                       A.nnz() * sizeof(INT_TYPE) + A.nnz() * sizeof(double) +
                       A.nnz() * sizeof(double) + A.num_rows() * sizeof(double);
 
-  double dot_bytes = x.extent(0) * sizeof(double) * 2;
-  double axpby_bytes = x.extent(0) * sizeof(double) * 3;
+  double dot_bytes = b.size() * sizeof(double) * 2;
+  double axpby_bytes = b.size() * sizeof(double) * 3;
 
   double spmv_flops = A.nnz() * 2;
-  double dot_flops = x.extent(0) * 2;
-  double axpby_flops = x.extent(0) * 3;
+  double dot_flops = b.size() * 2;
+  double axpby_flops = b.size() * 3;
 
   int spmv_calls = 1 + num_iters;
   int dot_calls = num_iters * 2;
@@ -275,3 +255,15 @@ int main(int argc, char *argv[]) {
     dot_calls,
     axpby_calls);
 }
+
+#elif (STDEXX_ARGOBOTS)
+
+auto main() -> int {} // todo
+
+#elif (STDEXX_REFERENCE)
+
+auto main() -> int {}
+
+#else
+error "Not implemented."
+#endif
@@ -0,0 +1,142 @@
+#ifndef CRS_MATRIX_HPP
+#define CRS_MATRIX_HPP
+
+#include <cstddef>
+#include <memory>
+#include <numeric>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <stdexx.hpp>
+
+#include "minife.hpp"
+
+// Allocator that leaves elements default-initialized, i.e. trivial ones
+// uninitialized. A vector using it doesn't touch its pages when it's
+// sized, so they end up on the NUMA node of whoever fills them first.
+template <class T>
+struct uninitialized_allocator : std::allocator<T> {
+  template <class U>
+  struct rebind {
+    using other = uninitialized_allocator<U>;
+  };
+
+  uninitialized_allocator() = default;
+
+  template <class U>
+  uninitialized_allocator(uninitialized_allocator<U> const &) noexcept {}
+
+  template <class U>
+  void construct(U *p) noexcept(std::is_nothrow_default_constructible_v<U>) {
+    ::new (static_cast<void *>(p)) U;
+  }
+
+  template <class U, class... Args>
+  void construct(U *p, Args &&...args) {
+    ::new (static_cast<void *>(p)) U(std::forward<Args>(args)...);
+  }
+};
+
+// Host CRS matrix for the stdexx versions of cgsolve.
+// Same layout as CrsMatrix in generate_matrix.hpp, in plain vectors
+// since those versions don't depend on Kokkos.
+struct crs_matrix {
+  using index_vector = std::vector<INT_TYPE, uninitialized_allocator<INT_TYPE>>;
+  using value_vector = std::vector<double, uninitialized_allocator<double>>;
+
+  index_vector row_ptr;
+  index_vector col_idx;
+  value_vector values;
+
+  INT_TYPE _num_cols;
+
+  INT_TYPE num_rows() const { return row_ptr.size() - 1; }
+
+  INT_TYPE num_cols() const { return _num_cols; }
+
+  INT_TYPE nnz() const { return values.size(); }
+};
+
+namespace Impl {
+// Serial miniFE matrix, trimmed to the entries actually generated.
+inline crs_matrix generate_miniFE_crs(int nx) {
+  INT_TYPE nrows = miniFE_num_rows(nx);
+
+  // Zeroed, miniFE_fill_matrix leaves gaps in some of the rows.
+  crs_matrix A{crs_matrix::index_vector(nrows + 1, 0),
+               crs_matrix::index_vector(std::size_t(nrows) * 27, 0),
+               crs_matrix::value_vector(std::size_t(nrows) * 27, 0.0),
+               nrows};
+  miniFE_fill_matrix(
+    A.row_ptr.data(), A.values.data(), A.col_idx.data(), 0, nrows, nx);
+  A.col_idx.resize(A.row_ptr[nrows]);
+  A.values.resize(A.row_ptr[nrows]);
+  return A;
+}
+
+#if (STDEXX_QTHREADS)
+// Parallel miniFE matrix, same entries as the serial one.
+// Row lengths are known from the row index alone, so row_ptr is a
+// parallel prefix sum of them: bulk_chunked has every chunk scan its
+// own rows, then the chunk totals are scanned and added back. col_idx
+// and values are then filled row by row with the same per-row bulk over
+// nrows as spmv, so each worker first-touches the entries it later
+// multiplies, and those pages get spread over the NUMA nodes the same
+// way as the work. row_ptr's chunks are cut differently, but it's only
+// one index per row next to 27 entries.
+template <class Scheduler>
+crs_matrix generate_miniFE_crs(Scheduler sched, int nx) {
+  INT_TYPE nrows = miniFE_num_rows(nx);
+  crs_matrix A{{}, {}, {}, nrows};
+  A.row_ptr.resize(std::size_t(nrows) + 1);
+
+  INT_TYPE *row_ptr = A.row_ptr.data();
+  std::size_t chunk_size = stdexx::qt_chunk_size(nrows, 0);
+  // Entries before each chunk of rows, chunk_offsets[0] stays 0.
+  std::vector<INT_TYPE> chunk_offsets((nrows + chunk_size - 1) / chunk_size +
+                                      1);
+  INT_TYPE *offsets = chunk_offsets.data();
+  stdexec::sync_wait(
+    stdexec::schedule(sched) |
+    stdexx::bulk_chunked(nrows,
+                         [=](INT_TYPE begin, INT_TYPE end) {
+                           INT_TYPE sum = 0;
+                           for (INT_TYPE row = begin; row < end; ++row) {
+                             sum += miniFE_row_length(row, nx);
+                             row_ptr[row + 1] = sum;
+                           }
+                           offsets[begin / chunk_size + 1] = sum;
+                         }) |
+    stdexec::then([&] {
+      row_ptr[0] = 0;
+      std::partial_sum(
+        chunk_offsets.begin(), chunk_offsets.end(), chunk_offsets.begin());
+    }) |
+    stdexx::bulk_chunked(nrows, [=](INT_TYPE begin, INT_TYPE end) {
+      INT_TYPE offset = offsets[begin / chunk_size];
+      for (INT_TYPE row = begin; row < end; ++row) row_ptr[row + 1] += offset;
+    }));
+
+  A.col_idx.resize(row_ptr[nrows]);
+  A.values.resize(row_ptr[nrows]);
+  INT_TYPE *col_idx = A.col_idx.data();
+  double *values = A.values.data();
+  stdexec::sync_wait(stdexec::schedule(sched) |
+                     stdexec::bulk(stdexec::par, nrows, [=](INT_TYPE row) {
+                       INT_TYPE offset = row_ptr[row];
+                       miniFE_fill_row(
+                         row, nx, values + offset, col_idx + offset);
+                     }));
+  return A;
+}
+#endif
+
+inline std::vector<double> generate_miniFE_rhs(int nx) {
+  INT_TYPE nrows = miniFE_num_rows(nx);
+  std::vector<double> b(nrows);
+  miniFE_fill_vector(b.data(), nx, 0, nrows);
+  return b;
+}
+} // namespace Impl
+#endif
@@ -0,0 +1,426 @@
+//@HEADER
+// ************************************************************************
+//
+//                        Kokkos v. 4.0
+//       Copyright (2022) National Technology & Engineering
+//               Solutions of Sandia, LLC (NTESS).
+//
+// Under the terms of Contract DE-NA0003525 with NTESS,
+// the U.S. Government retains certain rights in this software.
+//
+// Part of Kokkos, under the Apache License v2.0 with LLVM Exceptions.
+// See https://kokkos.org/LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//@HEADER
+
+#ifndef MINIFE_HPP
+#define MINIFE_HPP
+
+// Pointer level miniFE matrix and vector generation, shared by the
+// Kokkos and the stdexx versions of cgsolve.
+
+using INT_TYPE = int;
+
+namespace Impl {
+template <class GO, class S>
+static void miniFE_get_row(INT_TYPE *rows,
+                           S *vals,
+                           GO *cols,
+                           INT_TYPE startrow,
+                           INT_TYPE endrow,
+                           INT_TYPE &row,
+                           INT_TYPE o,
+                           INT_TYPE nx1,
+                           INT_TYPE c1,
+                           INT_TYPE c2,
+                           INT_TYPE c3,
+                           INT_TYPE val,
+                           INT_TYPE &miniFE_a,
+                           INT_TYPE &miniFE_b,
+                           INT_TYPE &miniFE_c) {
+  // FIXME (mfh 25 Jun 2014) Seriously, "val27"???  Who writes
+  // code like this???
+
+  bool val27 = false;
+  if (c1 * c2 * c3 == 27) { val27 = true; }
+  // printf("%li %li %li\n",c1,c2,c3);
+  if ((row >= startrow) && (row < endrow)) {
+    INT_TYPE offset = rows[row - startrow];
+    rows[row + 1 - startrow] = offset + c1 * c2 * c3;
+    for (INT_TYPE i = 0; i < c1; i++)
+      for (INT_TYPE j = 0; j < c2; j++)
+        for (INT_TYPE k = 0; k < c3; k++) {
+          INT_TYPE m = i * c2 * c3 + j * c2 + k;
+          cols[offset + m] = o + i * nx1 * nx1 + j * nx1 + k;
+          if (val27) {
+            bool doa = ((miniFE_a > 0) && (miniFE_a < nx1 - 3)) ||
+                       ((miniFE_a == 0) && (m / 9 >= 1)) ||
+                       ((miniFE_a == nx1 - 3) && (m / 9 < 2));
+            bool dob = ((miniFE_b > 0) && (miniFE_b < nx1 - 3)) ||
+                       ((miniFE_b == 0) && ((m % 9) / 3 >= 1)) ||
+                       ((miniFE_b == nx1 - 3) && ((m % 9) / 3 < 2));
+            bool doc = ((miniFE_c > 0) && (miniFE_c < nx1 - 3)) ||
+                       ((miniFE_c == 0) && ((m % 3) >= 1)) ||
+                       ((miniFE_c == nx1 - 3) && ((m % 3) < 2));
+            if (doa && dob && doc) {
+              if (m == 13) vals[offset + m] = 8.0 / 3.0 / (nx1 - 1);
+              else {
+                if (m % 2 == 1) vals[offset + m] = -5.0e-1 / 3.0 / (nx1 - 1);
+                else {
+                  if ((m == 4) || (m == 22) || ((m > 9) && (m < 17)))
+                    vals[offset + m] = -2.18960e-10 / (nx1 - 1);
+                  else vals[offset + m] = -2.5e-1 / 3.0 / (nx1 - 1);
+                }
+              }
+            } else vals[offset + m] = 0.0;
+          } else {
+            if (val == m) vals[offset + m] = 1.0;
+            else vals[offset + m] = 0.0;
+          }
+        }
+  }
+  if (c1 * c2 * c3 == 27) {
+    miniFE_c++;
+    if (miniFE_c > nx1 - 3) {
+      miniFE_c = 0;
+      miniFE_b++;
+    }
+    if (miniFE_b > nx1 - 3) {
+      miniFE_b = 0;
+      miniFE_a++;
+    }
+  }
+
+  row++;
+}
+
+template <class GO, class S>
+static void miniFE_get_block(INT_TYPE *rows,
+                             S *vals,
+                             GO *cols,
+                             INT_TYPE startrow,
+                             INT_TYPE endrow,
+                             INT_TYPE &row,
+                             INT_TYPE o,
+                             INT_TYPE nx1,
+                             INT_TYPE c1,
+                             INT_TYPE c2,
+                             INT_TYPE val1,
+                             INT_TYPE val2,
+                             INT_TYPE val3,
+                             INT_TYPE &miniFE_a,
+                             INT_TYPE &miniFE_b,
+                             INT_TYPE &miniFE_c) {
+  miniFE_get_row(rows,
+                 vals,
+                 cols,
+                 startrow,
+                 endrow,
+                 row,
+                 o,
+                 nx1,
+                 c1,
+                 c2,
+                 2,
+                 val1,
+                 miniFE_a,
+                 miniFE_b,
+                 miniFE_c);
+  for (INT_TYPE i = 0; i < nx1 - 2; i++)
+    miniFE_get_row(rows,
+                   vals,
+                   cols,
+                   startrow,
+                   endrow,
+                   row,
+                   o++,
+                   nx1,
+                   c1,
+                   c2,
+                   3,
+                   val2,
+                   miniFE_a,
+                   miniFE_b,
+                   miniFE_c);
+  miniFE_get_row(rows,
+                 vals,
+                 cols,
+                 startrow,
+                 endrow,
+                 row,
+                 o++,
+                 nx1,
+                 c1,
+                 c2,
+                 2,
+                 val3,
+                 miniFE_a,
+                 miniFE_b,
+                 miniFE_c);
+}
+
+template <class GO, class S>
+static void miniFE_get_superblock(INT_TYPE *rows,
+                                  S *vals,
+                                  GO *cols,
+                                  INT_TYPE startrow,
+                                  INT_TYPE endrow,
+                                  INT_TYPE &row,
+                                  INT_TYPE o,
+                                  INT_TYPE nx1,
+                                  INT_TYPE c1,
+                                  INT_TYPE val1,
+                                  INT_TYPE val2,
+                                  INT_TYPE val3,
+                                  INT_TYPE &miniFE_a,
+                                  INT_TYPE &miniFE_b,
+                                  INT_TYPE &miniFE_c) {
+  miniFE_get_block(rows,
+                   vals,
+                   cols,
+                   startrow,
+                   endrow,
+                   row,
+                   o,
+                   nx1,
+                   c1,
+                   2,
+                   val1 + 0,
+                   val1 + val2 + 1,
+                   val1 + 1,
+                   miniFE_a,
+                   miniFE_b,
+                   miniFE_c);
+  for (INT_TYPE i = 0; i < nx1 - 2; i++) {
+    miniFE_get_block(rows,
+                     vals,
+                     cols,
+                     startrow,
+                     endrow,
+                     row,
+                     o,
+                     nx1,
+                     c1,
+                     3,
+                     val1 + val2 + 3,
+                     val1 + val2 + val2 + val3 + 4,
+                     val1 + val2 + 4,
+                     miniFE_a,
+                     miniFE_b,
+                     miniFE_c);
+    o += nx1;
+  }
+  miniFE_get_block(rows,
+                   vals,
+                   cols,
+                   startrow,
+                   endrow,
+                   row,
+                   o,
+                   nx1,
+                   c1,
+                   2,
+                   val1 + 2,
+                   val1 + val2 + 3,
+                   val1 + 3,
+                   miniFE_a,
+                   miniFE_b,
+                   miniFE_c);
+}
+
+// Number of rows of the miniFE matrix for an nx^3 element mesh.
+inline INT_TYPE miniFE_num_rows(int nx) {
+  return (nx + 1) * (nx + 1) * (nx + 1);
+}
+
+// Fills rows [startrow, endrow) of the miniFE matrix. rows has to hold
+// endrow - startrow + 1 entries with rows[0] == 0, cols and vals 27 per
+// row. The rows are generated in order, so this is inherently serial.
+template <class GO, class S>
+static void miniFE_fill_matrix(INT_TYPE *rows,
+                               S *vals,
+                               GO *cols,
+                               INT_TYPE startrow,
+                               INT_TYPE endrow,
+                               int nx) {
+  INT_TYPE miniFE_a = 0;
+  INT_TYPE miniFE_b = 0;
+  INT_TYPE miniFE_c = 0;
+
+  INT_TYPE nx1 = nx + 1;
+
+  INT_TYPE row = 0;
+  miniFE_get_superblock(rows,
+                        vals,
+                        cols,
+                        startrow,
+                        endrow,
+                        row,
+                        0,
+                        nx1,
+                        2,
+                        0,
+                        0,
+                        0,
+                        miniFE_a,
+                        miniFE_b,
+                        miniFE_c);
+  for (INT_TYPE i = 0; i < nx1 - 2; i++) {
+    miniFE_get_superblock(rows,
+                          vals,
+                          cols,
+                          startrow,
+                          endrow,
+                          row,
+                          i * nx1 * nx1,
+                          nx1,
+                          3,
+                          4,
+                          2,
+                          1,
+                          miniFE_a,
+                          miniFE_b,
+                          miniFE_c);
+  }
+  miniFE_get_superblock(rows,
+                        vals,
+                        cols,
+                        startrow,
+                        endrow,
+                        row,
+                        (nx1 - 2) * nx1 * nx1,
+                        nx1,
+                        2,
+                        4,
+                        2,
+                        1,
+                        miniFE_a,
+                        miniFE_b,
+                        miniFE_c);
+}
+
+// Number of entries in row row of the miniFE matrix. Rows on a face of
+// the mesh have 2 instead of 3 neighbours along that axis.
+inline INT_TYPE miniFE_row_length(INT_TYPE row, int nx) {
+  INT_TYPE nx1 = nx + 1;
+  auto width = [nx](INT_TYPE i) -> INT_TYPE {
+    return i == 0 || i == nx ? 2 : 3;
+  };
+  return width(row / (nx1 * nx1)) * width(row / nx1 % nx1) * width(row % nx1);
+}
+
+// Generates row row of the miniFE matrix into cols[0, len) and
+// vals[0, len), len being miniFE_row_length(row, nx), without generating
+// the rows before it. The arguments miniFE_fill_matrix would have passed
+// to miniFE_get_row for this row are worked out from its coordinates in
+// the mesh, so the entries are exactly the same.
+// miniFE_get_row leaves gaps in some boundary rows and writes a couple of
+// entries past their end, which the next row then overwrites. It's run
+// on a zeroed scratch row here, so every row can be written on its own
+// and in any order.
+template <class GO, class S>
+static void miniFE_fill_row(INT_TYPE row, int nx, S *vals, GO *cols) {
+  INT_TYPE nx1 = nx + 1;
+  INT_TYPE a = row / (nx1 * nx1);
+  INT_TYPE b = row / nx1 % nx1;
+  INT_TYPE c = row % nx1;
+  auto width = [nx](INT_TYPE i) -> INT_TYPE {
+    return i == 0 || i == nx ? 2 : 3;
+  };
+  auto before = [](INT_TYPE i) -> INT_TYPE { return i > 0 ? i - 1 : 0; };
+
+  // Column offset, the o of miniFE_get_row.
+  INT_TYPE o = before(a) * nx1 * nx1 + before(b) * nx1 + before(c);
+
+  // val picks the single 1.0 of the rows of the boundary conditions. It
+  // is set per superblock, then per block, then per row.
+  INT_TYPE sv1 = a == 0 ? 0 : 4;
+  INT_TYPE sv2 = a == 0 ? 0 : 2;
+  INT_TYPE sv3 = a == 0 ? 0 : 1;
+  INT_TYPE bv1, bv2, bv3;
+  if (b == 0) {
+    bv1 = sv1;
+    bv2 = sv1 + sv2 + 1;
+    bv3 = sv1 + 1;
+  } else if (b == nx) {
+    bv1 = sv1 + 2;
+    bv2 = sv1 + sv2 + 3;
+    bv3 = sv1 + 3;
+  } else {
+    bv1 = sv1 + sv2 + 3;
+    bv2 = sv1 + sv2 + sv2 + sv3 + 4;
+    bv3 = sv1 + sv2 + 4;
+  }
+  INT_TYPE val = c == 0 ? bv1 : (c == nx ? bv3 : bv2);
+
+  // Position among the interior rows, only used by those.
+  INT_TYPE miniFE_a = before(a);
+  INT_TYPE miniFE_b = before(b);
+  INT_TYPE miniFE_c = before(c);
+
+  INT_TYPE rows[2] = {0, 0};
+  // Room for the 27 entries and what gets written past them.
+  S row_vals[32] = {};
+  GO row_cols[32] = {};
+  INT_TYPE r = row;
+  miniFE_get_row(rows,
+                 row_vals,
+                 row_cols,
+                 row,
+                 row + 1,
+                 r,
+                 o,
+                 nx1,
+                 width(a),
+                 width(b),
+                 width(c),
+                 val,
+                 miniFE_a,
+                 miniFE_b,
+                 miniFE_c);
+  for (INT_TYPE m = 0; m < rows[1]; ++m) {
+    vals[m] = row_vals[m];
+    cols[m] = row_cols[m];
+  }
+}
+
+template <class S>
+static void miniFE_vector_generate_block(
+  S *vec, int nx, S a, S b, int &count, int start, int end) {
+  if ((count >= start) && (count < end)) vec[count++ - start] = 0;
+  for (int i = 0; i < nx - 2; i++)
+    if ((count >= start) && (count < end))
+      vec[count++ - start] = a / nx / nx / nx;
+  if ((count >= start) && (count < end))
+    vec[count++ - start] = a / nx / nx / nx + b / nx;
+  if ((count >= start) && (count < end)) vec[count++ - start] = 1;
+}
+
+template <class S>
+static void miniFE_vector_generate_superblock(
+  S *vec, int nx, S a, S b, S c, int &count, int start, int end) {
+  miniFE_vector_generate_block(vec, nx, 0.0, 0.0, count, start, end);
+  miniFE_vector_generate_block(vec, nx, a, b, count, start, end);
+  for (int i = 0; i < nx - 3; i++)
+    miniFE_vector_generate_block(vec, nx, a, c, count, start, end);
+  miniFE_vector_generate_block(vec, nx, a, b, count, start, end);
+  miniFE_vector_generate_block(vec, nx, 0.0, 0.0, count, start, end);
+}
+
+// Fills entries [start, end) of the miniFE right hand side.
+template <class S>
+static void miniFE_fill_vector(S *vec, int nx, int start, int end) {
+  int count = 0;
+  miniFE_vector_generate_superblock(vec, nx, 0.0, 0.0, 0.0, count, start, end);
+  miniFE_vector_generate_superblock(
+    vec, nx, 1.0, 5.0 / 12, 8.0 / 12, count, start, end);
+  for (int i = 0; i < nx - 3; i++)
+    miniFE_vector_generate_superblock(
+      vec, nx, 1.0, 8.0 / 12, 1.0, count, start, end);
+  miniFE_vector_generate_superblock(
+    vec, nx, 1.0, 5.0 / 12, 8.0 / 12, count, start, end);
+  miniFE_vector_generate_superblock(vec, nx, 0.0, 0.0, 0.0, count, start, end);
+}
+} // namespace Impl
+#endif
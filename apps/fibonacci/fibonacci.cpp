@@ -14,15 +14,188 @@
  * limitations under the License.
  */
 
+#include <chrono>
 #include <cstdlib>
+#include <exception>
 #include <iostream>
 #include <numeric>
+#include <vector>
 
 #include <exec/static_thread_pool.hpp>
 #include <stdexx.hpp>
 
 #if (STDEXX_QTHREADS)
 
+auto serial_fib(long n) -> long {
+  return n < 2 ? n : serial_fib(n - 1) + serial_fib(n - 2);
+}
+
+// Number of fib() calls at or above the cutoff, each of which forks a child.
+auto num_splits(long cutoff, long n) -> long {
+  if (n < cutoff) return 0;
+  return 1 + num_splits(cutoff, n - 1) + num_splits(cutoff, n - 2);
+}
+
+auto fib(long cutoff, long n) -> long;
+
+/*
+- Qthreads sender computing fib(n)
+- Its op state forks one qthread (via qt_os_base) that runs fib()
+- No type erasure: the children are fib_s senders connected to a
+  fixed receiver type, so the op state type doesn't recurse
+*/
+struct fib_s : stdexx::qthreads_base_sender<fib_s> {
+  using completion_signatures =
+    stdexec::completion_signatures<stdexec::set_value_t(long),
+                                   stdexec::set_stopped_t(),
+                                   stdexec::set_error_t(int)>;
+
+  long cutoff;
+  long n;
+
+  template <class Receiver>
+  struct operation : stdexx::qt_os_base<operation<Receiver>, Receiver> {
+    long cutoff;
+    long n;
+
+    template <class Receiver_>
+    operation(Receiver_ &&rcvr, long cutoff_, long n_):
+      stdexx::qt_os_base<operation<Receiver>, Receiver>(
+        std::forward<Receiver_>(rcvr)),
+      cutoff(cutoff_), n(n_) {}
+
+    static aligned_t task(void *arg) noexcept {
+      auto *os = static_cast<operation *>(arg);
+      os->complete_value(fib(os->cutoff, os->n));
+      return 0u;
+    }
+  };
+
+  template <class Receiver>
+  auto connect(Receiver &&rcvr) && -> operation<Receiver> {
+    return {std::forward<Receiver>(rcvr), cutoff, n};
+  }
+};
+
+/*
+- Join point for a child fib_s
+- Lives on the stack of the parent qthread next to the child op state
+- The parent suspends on the FEB, which only parks its ULT
+*/
+struct fib_join {
+  aligned_t feb;
+  long value = 0;
+
+  fib_join(): feb(0u) { qthread_empty(&feb); }
+
+  auto wait() -> long {
+    qthread_readFF(NULL, &feb);
+    return value;
+  }
+};
+
+struct fib_receiver {
+  using receiver_concept = stdexec::receiver_t;
+  fib_join *join;
+
+  void set_value(long v) noexcept {
+    join->value = v;
+    qthread_fill(&join->feb);
+  }
+
+  // There's no way to hand a failure up through fib(), and returning
+  // some value instead would only give a wrong result, so give up.
+  void set_error(int err) noexcept {
+    std::cerr << "fibonacci: forking a child failed with " << err
+              << std::endl;
+    std::terminate();
+  }
+
+  // Nothing here requests stop, so this can't happen.
+  void set_stopped() noexcept {
+    std::cerr << "fibonacci: child was stopped" << std::endl;
+    std::terminate();
+  }
+
+  stdexx::qthreads_env get_env() const noexcept { return {}; }
+};
+
+// Runs inside a qthread. Forks fib(n - 1) as a child, computes
+// fib(n - 2) in the current qthread and then waits for the child.
+auto fib(long cutoff, long n) -> long {
+  if (n < cutoff) return serial_fib(n);
+
+  fib_join join;
+  auto child =
+    stdexec::connect(fib_s{{}, cutoff, n - 1}, fib_receiver{&join});
+  stdexec::start(child);
+  long b = fib(cutoff, n - 2);
+  return join.wait() + b;
+}
+
+template <typename duration, typename F>
+auto measure(F &&f) {
+  std::chrono::steady_clock::time_point start =
+    std::chrono::steady_clock::now();
+  f();
+  return std::chrono::duration_cast<duration>(std::chrono::steady_clock::now() -
+                                              start)
+    .count();
+}
+
+int main(int argc, char **argv) {
+  if (argc < 4) {
+    std::cerr << "Usage: fibonacci cutoff n nruns" << std::endl;
+    return -1;
+  }
+
+  // skip 'warmup' iterations for performance measurements
+  static constexpr size_t warmup = 1;
+
+  long cutoff = std::strtol(argv[1], nullptr, 10);
+  long n = std::strtol(argv[2], nullptr, 10);
+  std::size_t nruns = std::strtoul(argv[3], nullptr, 10);
+
+  // fib() splits n into n - 1 and n - 2 for any n >= cutoff, which goes
+  // negative below 2.
+  if (cutoff < 2) {
+    std::cerr << "cutoff should be >= 2" << std::endl;
+    return -1;
+  }
+
+  if (nruns <= warmup) {
+    std::cerr << "nruns should be > " << warmup << std::endl;
+    return -1;
+  }
+
+  stdexx::init();
+
+  std::vector<unsigned long> times;
+  long result = 0;
+  for (unsigned long i = 0; i < nruns; ++i) {
+    auto time = measure<std::chrono::microseconds>([&] {
+      auto [r] = stdexec::sync_wait(fib_s{{}, cutoff, n}).value();
+      result = r;
+    });
+    times.push_back(static_cast<unsigned long>(time));
+  }
+
+  stdexx::finalize();
+
+  unsigned long avg =
+    std::accumulate(times.begin() + warmup, times.end(), 0ul) /
+    (times.size() - warmup);
+  // The root fib_s plus one child per split.
+  long tasks = 1 + num_splits(cutoff, n);
+
+  std::cout << "Avg time: " << avg / 1000.0 << "ms. Result: " << result
+            << std::endl;
+  std::cout << "Tasks: " << tasks << ". Avg time per task: "
+            << (tasks ? 1000.0 * avg / tasks : 0.0) << "ns" << std::endl;
+}
+
+#elif (STDEXX_ARGOBOTS)
+
 auto main() -> int {} // todo
 
 #elif (STDEXX_REFERENCE)
@@ -88,8 +261,8 @@ struct fib_s {
   - ! The callback is called on completion of op::start
   */
   template <stdexec::receiver_of<completion_signatures> Receiver>
-  auto connect(Receiver rcv) noexcept -> op<Receiver> {
-    return {static_cast<Receiver &&>(rcvr), self.cutoff, self.n, self.sched};
+  auto connect(Receiver rcvr) noexcept -> operation<Receiver> {
+    return {static_cast<Receiver &&>(rcvr), cutoff, n, sched};
   }
 };
 
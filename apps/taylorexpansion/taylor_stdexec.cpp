@@ -4,39 +4,30 @@
 //  Distributed under the Boost Software License, Version 1.0. (See accompanying
 //  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
 
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <ranges>
+#include <string>
+
 #include <stdexx.hpp>
 
-template <typename T>
-concept sender = is_sender_v<T>;
-
-double run(size_t n, size_t num_threads, double x) {
-  thread_pool_scheduler sch{};
-
-  size_t partition_size = n / num_threads;
-  std::vector<double> partial_results(partition_size);
-
-  sender auto s = schedule(sch) |
-                  bulk(num_threads,
-                       [&](auto i) {
-                         size_t begin = i * partition_size;
-                         size_t end = (i + 1) * partition_size;
-                         if (i == num_threads - 1) end = n;
-                         double partial_sum = 0;
-                         for (int i = begin; i <= end; i++) {
-                           double e = i + 1;
-                           double term =
-                             std::pow(-1.0, e + 1) * std::pow(x, e) / e;
-                           partial_sum += term;
-                         }
-                         partial_results[i] = partial_sum;
-                       }) |
-                  then([&]() {
-                    double sum = 0;
-                    for (int i = 0; i < partition_size; i++)
-                      sum += partial_results[i];
-                    return sum;
-                  });
-  auto result = hpx::get<0>(*stdexec::sync_wait(std::move(s)));
+#if (STDEXX_QTHREADS)
+
+// Sums the first n terms of the Taylor series of log(1 + x).
+// stdexx::reduce keeps one padded partial per worker and adds them up in
+// a fixed order, so the result is the same on every run.
+double run(stdexx::qthreads_scheduler sch, size_t n, double x) {
+  auto terms = std::views::iota(size_t(0), n) |
+               std::views::transform([x](size_t i) {
+                 double e = i + 1;
+                 return std::pow(-1.0, e + 1) * std::pow(x, e) / e;
+               });
+  auto [result] =
+    stdexec::sync_wait(stdexx::reduce(sch, terms, 0.0, std::plus<>{}))
+      .value();
   return result;
 }
 
@@ -45,8 +36,11 @@ int main(int args, char **argv) {
   double x = std::stod(argv[2]);
   size_t n = std::stoi(argv[1]);
 
+  stdexx::runtime rt({.num_shepherds = 1,
+                      .workers_per_shepherd = static_cast<int>(threads)});
+
   auto start = std::chrono::high_resolution_clock::now();
-  double result = run(n, threads, x);
+  double result = run(rt.get_scheduler(), n, x);
   auto end = std::chrono::high_resolution_clock::now();
   std::chrono::duration<double> diff = end - start;
   std::cout << threads << "," << diff.count() << std::endl;
@@ -55,3 +49,15 @@ int main(int args, char **argv) {
             << " after " << n << " iterations." << std::endl;
   return EXIT_SUCCESS;
 }
+
+#elif (STDEXX_ARGOBOTS)
+
+auto main() -> int {} // todo
+
+#elif (STDEXX_REFERENCE)
+
+auto main() -> int {}
+
+#else
+error "Not implemented."
+#endif
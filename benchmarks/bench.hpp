@@ -0,0 +1,181 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <latch>
+#include <optional>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include <stdexx.hpp>
+
+#if (STDEXX_REFERENCE)
+#include <exec/static_thread_pool.hpp>
+#endif
+
+namespace bench {
+
+// Backend shims. Each backend provides its name, a runtime object
+// that is alive for the whole run, and a scheduler to run work on.
+// The cases compare qthreads against plain stdexec, so those are the
+// only two backends.
+#if (STDEXX_QTHREADS)
+
+inline constexpr char const *backend_name = "qthreads";
+
+struct runtime {
+  stdexx::runtime rt;
+
+  stdexx::qthreads_scheduler get_scheduler() const noexcept { return {}; }
+};
+
+#elif (STDEXX_REFERENCE)
+
+inline constexpr char const *backend_name = "reference";
+
+struct runtime {
+  exec::static_thread_pool pool{std::thread::hardware_concurrency()};
+
+  auto get_scheduler() noexcept { return pool.get_scheduler(); }
+};
+
+#else
+#error "stdexx_bench only supports the qthreads and reference backends."
+#endif
+
+struct result {
+  std::string name;
+  std::string param;
+  std::size_t iterations;
+  double value;
+  // What value measures, used as its key in the JSON output.
+  char const *metric = "ns_per_op";
+  // Caveat printed next to the value, if any.
+  char const *note = nullptr;
+};
+
+// Collects timings and prints them as JSON so runs can be diffed
+// between releases.
+class suite {
+public:
+  suite(std::string filter, double scale): filter_(filter), scale_(scale) {}
+
+  // Times iterations calls of f, after a short warmup, and records the
+  // average time per call divided by ops_per_call.
+  template <class F>
+  void run(std::string const &name,
+           std::string const &param,
+           std::size_t iterations,
+           F &&f,
+           std::size_t ops_per_call = 1) {
+    if (!enabled(name)) return;
+    iterations = std::max<std::size_t>(1, iterations * scale_);
+
+    for (std::size_t i = 0; i < std::max<std::size_t>(1, iterations / 10);
+         ++i) {
+      f();
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i < iterations; ++i) f();
+    auto stop = std::chrono::steady_clock::now();
+
+    double ns = std::chrono::duration<double, std::nano>(stop - start).count();
+    results_.push_back(
+      {name, param, iterations, ns / iterations / ops_per_call});
+  }
+
+  // Whether a benchmark with the given name passes the filter, for
+  // benchmarks that do their own measuring and call record().
+  bool enabled(std::string const &name) const {
+    return filter_.empty() || name.find(filter_) != std::string::npos;
+  }
+
+  // Records a value measured by the caller, e.g. memory use.
+  void record(std::string const &name,
+              std::string const &param,
+              std::size_t iterations,
+              double value,
+              char const *metric,
+              char const *note = nullptr) {
+    if (!enabled(name)) return;
+    results_.push_back({name, param, iterations, value, metric, note});
+  }
+
+  void print_json(std::FILE *out = stdout) const {
+    std::fprintf(
+      out, "{\n  \"backend\": \"%s\",\n  \"results\": [", backend_name);
+    for (std::size_t i = 0; i < results_.size(); ++i) {
+      auto const &r = results_[i];
+      std::fprintf(out,
+                   "%s\n    {\"name\": \"%s\", \"param\": \"%s\", "
+                   "\"iterations\": %zu, \"%s\": %.3f",
+                   i ? "," : "",
+                   r.name.c_str(),
+                   r.param.c_str(),
+                   r.iterations,
+                   r.metric,
+                   r.value);
+      if (r.note) std::fprintf(out, ", \"note\": \"%s\"", r.note);
+      std::fprintf(out, "}");
+    }
+    std::fprintf(out, "\n  ]\n}\n");
+  }
+private:
+  std::string filter_;
+  double scale_;
+  std::vector<result> results_;
+};
+
+// Receiver counting down a latch, used to keep many operations
+// in flight at once and wait for all of them from the main thread.
+struct latch_receiver {
+  using receiver_concept = stdexec::receiver_t;
+  std::latch *done;
+
+  template <class... As>
+  void set_value(As &&...) noexcept {
+    done->count_down();
+  }
+
+  template <class E>
+  void set_error(E &&) noexcept {
+    done->count_down();
+  }
+
+  void set_stopped() noexcept { done->count_down(); }
+
+  stdexec::env<> get_env() const noexcept { return {}; }
+};
+
+// Helper for emplacing immovable operation states.
+template <class F>
+struct emplace_from {
+  F f;
+
+  operator std::invoke_result_t<F>() && { return static_cast<F &&>(f)(); }
+};
+
+template <class F>
+emplace_from(F) -> emplace_from<F>;
+
+// Connects and starts n senders made by make(i), then waits for all.
+template <class MakeSender>
+void start_all(std::size_t n, MakeSender &&make) {
+  using op_t = stdexec::connect_result_t<decltype(make(std::size_t{})),
+                                         latch_receiver>;
+  std::latch done{static_cast<std::ptrdiff_t>(n)};
+  std::vector<std::optional<op_t>> ops(n);
+  for (std::size_t i = 0; i < n; ++i) {
+    ops[i].emplace(emplace_from{
+      [&] { return stdexec::connect(make(i), latch_receiver{&done}); }});
+  }
+  for (auto &op : ops) stdexec::start(*op);
+  done.wait();
+}
+
+} // namespace bench
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <bench.hpp>
+
+namespace bench {
+
+#if (STDEXX_QTHREADS)
+
+// Cache line aligned array of doubles, so that bulk_chunked's chunk
+// boundaries fall on cache line boundaries.
+struct aligned_vector {
+  struct deleter {
+    void operator()(double *p) const noexcept { std::free(p); }
+  };
+
+  std::unique_ptr<double[], deleter> data;
+
+  explicit aligned_vector(std::size_t n, double value):
+    data(static_cast<double *>(std::aligned_alloc(
+      stdexx::qt_cache_line_size,
+      (n * sizeof(double) + stdexx::qt_cache_line_size - 1) /
+        stdexx::qt_cache_line_size * stdexx::qt_cache_line_size))) {
+    for (std::size_t i = 0; i < n; ++i) data[i] = value;
+  }
+};
+
+// AXPBY and DOT with stdexec::bulk, which calls the kernel once per
+// index, against stdexx::bulk_chunked, which hands it whole ranges.
+// The per-index DOT goes through fused_bulk's reduction since bulk
+// itself can't reduce. Reported per element.
+template <class Sched>
+void bulk_benchmarks(suite &s, Sched sched) {
+  for (std::size_t n : {std::size_t(1) << 16, std::size_t(1) << 22}) {
+    aligned_vector xv(n, 1.0), yv(n, 2.0), zv(n, 0.0);
+    double *z = zv.data.get();
+    double const *x = xv.data.get();
+    double const *y = yv.data.get();
+    double const a = 0.5, b = 0.25;
+    std::size_t iterations = n > (std::size_t(1) << 20) ? 50 : 1000;
+    std::string param = std::to_string(n);
+
+    s.run(
+      "axpby_bulk",
+      param,
+      iterations,
+      [&] {
+        stdexec::sync_wait(
+          stdexec::schedule(sched) |
+          stdexec::bulk(stdexec::par, n, [=](std::size_t i) {
+            z[i] = a * x[i] + b * y[i];
+          }));
+      },
+      n);
+    s.run(
+      "axpby_bulk_chunked",
+      param,
+      iterations,
+      [&] {
+        stdexec::sync_wait(
+          stdexec::schedule(sched) |
+          stdexx::bulk_chunked(n, [=](std::size_t begin, std::size_t end) {
+            for (std::size_t i = begin; i < end; ++i) {
+              z[i] = a * x[i] + b * y[i];
+            }
+          }));
+      },
+      n);
+
+    s.run(
+      "dot_bulk",
+      param,
+      iterations,
+      [&] {
+        stdexec::sync_wait(
+          stdexec::schedule(sched) |
+          stdexx::fused_bulk(n).then_reduce(
+            0.0, [=](std::size_t i, double &acc) { acc += x[i] * y[i]; }));
+      },
+      n);
+
+    // Chunk c starts at c * chunk_size, so every chunk can write its sum
+    // to a padded partial of its own.
+    std::size_t chunk_size = stdexx::qt_chunk_size(n, 0);
+    std::vector<stdexx::qt_padded<double>> partials(
+      (n + chunk_size - 1) / chunk_size);
+    auto *p = partials.data();
+    s.run(
+      "dot_bulk_chunked",
+      param,
+      iterations,
+      [&] {
+        stdexec::sync_wait(
+          stdexec::schedule(sched) |
+          stdexx::bulk_chunked(n,
+                               [=](std::size_t begin, std::size_t end) {
+                                 double sum = 0;
+                                 for (std::size_t i = begin; i < end; ++i) {
+                                   sum += x[i] * y[i];
+                                 }
+                                 p[begin / chunk_size].value = sum;
+                               }) |
+          stdexec::then([&] {
+            double sum = 0;
+            for (auto const &partial : partials) sum += partial.value;
+            return sum;
+          }));
+      },
+      n);
+  }
+}
+
+#endif
+
+} // namespace bench
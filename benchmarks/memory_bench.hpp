@@ -0,0 +1,141 @@
+#pragma once
+
+#include <unistd.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdio>
+#include <latch>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <bench.hpp>
+
+namespace bench {
+
+// Current resident set size in bytes, read from /proc/self/statm.
+// Returns 0 where that isn't available.
+inline std::size_t resident_bytes() {
+  std::FILE *f = std::fopen("/proc/self/statm", "r");
+  if (!f) return 0;
+  unsigned long size = 0, resident = 0;
+  int n = std::fscanf(f, "%lu %lu", &size, &resident);
+  std::fclose(f);
+  return n == 2 ? resident * sysconf(_SC_PAGESIZE) : 0;
+}
+
+#if (STDEXX_QTHREADS)
+
+// Gate for the small stack measurement. Simple qthreads can't block, so
+// they're held back by keeping every worker busy instead: hold_worker
+// spins without yielding until released, and everything spawned after
+// it stays queued.
+struct worker_hold {
+  std::atomic<bool> go{false};
+  std::atomic<int> started{0};
+};
+
+inline aligned_t hold_worker(void *arg) {
+  auto *hold = static_cast<worker_hold *>(arg);
+  hold->started.fetch_add(1);
+  while (!hold->go.load(std::memory_order_acquire)) {}
+  return 0;
+}
+
+// Gate for the large stack measurement. Every task counts itself in and
+// then suspends on gate, and the last one in fills all_blocked.
+struct blocked_tasks {
+  std::size_t ntasks;
+  std::atomic<std::size_t> started{0};
+  aligned_t all_blocked{0};
+  aligned_t gate{0};
+
+  void block() {
+    if (started.fetch_add(1) + 1 == ntasks) qthread_fill(&all_blocked);
+    qthread_readFF(NULL, &gate);
+  }
+};
+
+// Resident memory added per task while ntasks tasks are outstanding at
+// once. The operation states are connected before the baseline is
+// taken, so only what the runtime allocates per task is counted.
+// Small tasks are spawned but held in the queues behind busy workers,
+// which is all a small task ever is until it runs to completion. Large
+// tasks are started and suspended on a FEB, like the parents of a
+// recursive decomposition, so their stacks have actually been used.
+template <class Sched>
+double resident_bytes_per_task(Sched sched,
+                               stdexx::stack_class stack,
+                               std::size_t ntasks) {
+  blocked_tasks tasks{ntasks};
+  bool small = stack == stdexx::stack_class::small;
+  auto make = [&] {
+    return stdexec::schedule(sched) | stdexec::then([&tasks, small] {
+             if (!small) tasks.block();
+           });
+  };
+  using op_t = stdexec::connect_result_t<decltype(make()), latch_receiver>;
+
+  std::latch done{static_cast<std::ptrdiff_t>(ntasks)};
+  std::vector<std::optional<op_t>> ops(ntasks);
+  for (auto &op : ops) {
+    op.emplace(emplace_from{
+      [&] { return stdexec::connect(make(), latch_receiver{&done}); }});
+  }
+
+  // For small tasks, occupy every worker but the one running this, which
+  // doesn't yield until the measurement is done.
+  worker_hold hold;
+  int nholds = small ? static_cast<int>(qthread_num_workers()) - 1 : 0;
+  std::vector<aligned_t> febs(nholds);
+  for (auto &feb : febs) qthread_fork(&hold_worker, &hold, &feb);
+  while (hold.started.load() < nholds) {}
+  if (!small) {
+    qthread_empty(&tasks.all_blocked);
+    qthread_empty(&tasks.gate);
+  }
+
+  std::size_t before = resident_bytes();
+  for (auto &op : ops) stdexec::start(*op);
+  if (!small) qthread_readFF(NULL, &tasks.all_blocked);
+  std::size_t after = resident_bytes();
+
+  hold.go.store(true, std::memory_order_release);
+  if (!small) qthread_fill(&tasks.gate);
+  done.wait();
+  for (auto &feb : febs) qthread_readFF(NULL, &feb);
+
+  return after > before ? double(after - before) / ntasks : 0.0;
+}
+
+// Both stack classes side by side. Small tasks are measured first, since
+// qthreads keeps the stacks of finished large ones around for reuse.
+inline void memory_benchmarks(suite &s, std::size_t ntasks) {
+  if (!s.enabled("outstanding_task_rss") || ntasks == 0) return;
+  double small = resident_bytes_per_task(
+    stdexx::qthreads_stack_scheduler{stdexx::stack_class::small},
+    stdexx::stack_class::small,
+    ntasks);
+  s.record("outstanding_task_rss",
+           "small/" + std::to_string(ntasks),
+           ntasks,
+           small,
+           "rss_bytes_per_task",
+           "spawned, queued behind busy workers; small tasks can't block, "
+           "so they can only be leaves");
+  double large = resident_bytes_per_task(
+    stdexx::qthreads_stack_scheduler{stdexx::stack_class::large},
+    stdexx::stack_class::large,
+    ntasks);
+  s.record("outstanding_task_rss",
+           "large/" + std::to_string(ntasks),
+           ntasks,
+           large,
+           "rss_bytes_per_task",
+           "started and suspended on a FEB");
+}
+
+#endif
+
+} // namespace bench
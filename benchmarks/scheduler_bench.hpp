@@ -0,0 +1,145 @@
+#pragma once
+
+#include <exception>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <bench.hpp>
+
+namespace bench {
+
+// Sender that fails `failures` times before succeeding.
+// Used to measure what a single retry restart costs.
+struct fail_n {
+  using sender_concept = stdexec::sender_t;
+  using completion_signatures =
+    stdexec::completion_signatures<stdexec::set_value_t(),
+                                   stdexec::set_error_t(std::exception_ptr)>;
+
+  std::size_t *count;
+  std::size_t failures;
+
+  template <class R>
+  struct op {
+    R r_;
+    std::size_t *count;
+    std::size_t failures;
+
+    void start() & noexcept {
+      if ((*count)++ < failures) {
+        stdexec::set_error(std::move(r_), std::exception_ptr{});
+      } else {
+        stdexec::set_value(std::move(r_));
+      }
+    }
+  };
+
+  template <stdexec::receiver R>
+  auto connect(R r) const noexcept -> op<R> {
+    return {std::move(r), count, failures};
+  }
+};
+
+template <class Sched>
+auto fan_out_child(Sched sched) {
+  return stdexec::schedule(sched) | stdexec::then([] {});
+}
+
+template <class Sched, std::size_t... Is>
+auto fan_out(Sched sched, std::index_sequence<Is...>) {
+  return stdexec::when_all(((void)Is, fan_out_child(sched))...);
+}
+
+template <class Sched, std::size_t... Is>
+auto fan_out_nested(Sched sched, std::index_sequence<Is...>) {
+  return stdexec::when_all(
+    ((void)Is, fan_out(sched, std::make_index_sequence<64>{}))...);
+}
+
+template <class Sched>
+void scheduler_benchmarks(suite &s, Sched sched) {
+  s.run("schedule_then_sync_wait", "", 10000, [&] {
+    stdexec::sync_wait(stdexec::schedule(sched) |
+                       stdexec::then([] { return 1; }));
+  });
+
+  // Many forks in flight at once, reported per fork.
+  constexpr std::size_t nforks = 1000;
+  s.run(
+    "fork_throughput",
+    std::to_string(nforks),
+    100,
+    [&] {
+      start_all(nforks, [&](std::size_t i) {
+#if (STDEXX_QTHREADS)
+        return stdexx::qthreads_func_sender(
+          [](std::size_t v) { return static_cast<aligned_t>(v); }, i);
+#elif (STDEXX_REFERENCE)
+        return stdexec::schedule(sched) | stdexec::then([i] { return i; });
+#endif
+      });
+    },
+    nforks);
+
+  // The payload is moved back out every time, so any hidden copy
+  // shows up as a cost proportional to its size.
+  for (std::size_t bytes : {std::size_t{64}, std::size_t{1} << 20}) {
+    std::vector<char> payload(bytes);
+    s.run("just_sender_move", std::to_string(bytes), 1000, [&] {
+#if (STDEXX_QTHREADS)
+      auto [v] =
+        stdexec::sync_wait(stdexx::qthreads_just_sender(std::move(payload)))
+          .value();
+#elif (STDEXX_REFERENCE)
+      auto [v] = stdexec::sync_wait(stdexec::starts_on(
+                                      sched, stdexec::just(std::move(payload))))
+                   .value();
+#endif
+      payload = std::move(v);
+    });
+  }
+
+  // Reported per restart.
+  constexpr std::size_t restarts = 100;
+  s.run(
+    "retry_restart",
+    std::to_string(restarts),
+    1000,
+    [&] {
+      std::size_t count = 0;
+      stdexec::sync_wait(test::retry(fail_n{&count, restarts}));
+    },
+    restarts);
+
+  s.run("when_all_fan_out", "1", 10000, [&] {
+    stdexec::sync_wait(fan_out(sched, std::make_index_sequence<1>{}));
+  });
+  s.run("when_all_fan_out", "8", 10000, [&] {
+    stdexec::sync_wait(fan_out(sched, std::make_index_sequence<8>{}));
+  });
+  s.run("when_all_fan_out", "64", 1000, [&] {
+    stdexec::sync_wait(fan_out(sched, std::make_index_sequence<64>{}));
+  });
+  // 1024 children as 16 nested when_alls of 64, a flat 1024-ary
+  // when_all is too much for the compiler.
+  s.run("when_all_fan_out", "1024", 100, [&] {
+    stdexec::sync_wait(fan_out_nested(sched, std::make_index_sequence<16>{}));
+  });
+
+#if (STDEXX_QTHREADS)
+  // Same fan-out with the child count only known at runtime.
+  for (std::size_t n : {1, 8, 64, 1024}) {
+    s.run("when_all_range_fan_out", std::to_string(n), 10000 / n + 100, [&] {
+      std::vector<decltype(fan_out_child(sched))> children;
+      children.reserve(n);
+      for (std::size_t i = 0; i < n; ++i) {
+        children.push_back(fan_out_child(sched));
+      }
+      stdexec::sync_wait(stdexx::when_all_range(std::move(children)));
+    });
+  }
+#endif
+}
+
+} // namespace bench
@@ -0,0 +1,35 @@
+// Microbenchmarks for the scheduler hot paths.
+//
+// Usage: stdexx_bench [filter] [scale]
+//   filter: only run benchmarks whose name contains this string
+//   scale:  multiplier applied to the iteration counts
+//
+// Results are written to stdout as JSON.
+
+#include <cstdlib>
+#include <string>
+
+#include <bench.hpp>
+#include <bulk_bench.hpp>
+#include <memory_bench.hpp>
+#include <scheduler_bench.hpp>
+#include <then_bench.hpp>
+
+int main(int argc, char **argv) {
+  std::string filter = argc > 1 ? argv[1] : "";
+  double scale = argc > 2 ? std::strtod(argv[2], nullptr) : 1.0;
+
+  bench::runtime rt;
+  bench::suite s{filter, scale};
+
+  bench::scheduler_benchmarks(s, rt.get_scheduler());
+#if (STDEXX_QTHREADS)
+  stdexx::qthreads_context ctx;
+  bench::then_benchmarks(s, rt.get_scheduler(), ctx);
+  bench::memory_benchmarks(s, static_cast<std::size_t>(1000000 * scale));
+  bench::bulk_benchmarks(s, rt.get_scheduler());
+#endif
+
+  s.print_json();
+  return 0;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+#include <bench.hpp>
+
+namespace bench {
+
+#if (STDEXX_QTHREADS)
+
+// The v1 then (qthreads_then_sender, via stdexec::then on a qthreads
+// sender) against the v2 stdexx::then(prev, ctx, work).
+// Both fork exactly one qthread and invoke the same function once,
+// so the difference is the cost of the sender plumbing itself.
+inline aligned_t then_work() { return 1; }
+
+template <class Sched>
+void then_benchmarks(suite &s, Sched sched, stdexx::qthreads_context &ctx) {
+  s.run("then_v1", "", 10000, [&] {
+    stdexec::sync_wait(stdexec::schedule(sched) | stdexec::then(&then_work));
+  });
+  s.run("then_v2", "", 10000, [&] {
+    stdexec::sync_wait(stdexx::then(
+      stdexec::just(), ctx, stdexx::qthreads_basic_func_sender(&then_work)));
+  });
+
+  // Many operations in flight at once, reported per operation.
+  constexpr std::size_t nops = 1000;
+  s.run(
+    "then_v1_throughput",
+    std::to_string(nops),
+    100,
+    [&] {
+      start_all(nops, [&](std::size_t) {
+        return stdexec::schedule(sched) | stdexec::then(&then_work);
+      });
+    },
+    nops);
+  s.run(
+    "then_v2_throughput",
+    std::to_string(nops),
+    100,
+    [&] {
+      start_all(nops, [&](std::size_t) {
+        return stdexx::then(stdexec::just(),
+                            ctx,
+                            stdexx::qthreads_basic_func_sender(&then_work));
+      });
+    },
+    nops);
+}
+
+#endif
+
+} // namespace bench
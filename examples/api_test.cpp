@@ -65,6 +65,10 @@ auto main() -> int {
   return 0;
 }
 
+#elif (STDEXX_ARGOBOTS)
+
+auto main() -> int {} // todo
+
 #elif (STDEXX_REFERENCE)
 
 auto main() -> int {
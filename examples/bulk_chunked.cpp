@@ -0,0 +1,78 @@
+#include <atomic>
+#include <memory>
+
+#include <stdexx.hpp>
+
+#if (STDEXX_QTHREADS)
+
+#include <catch2/catch_session.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+// Runs bulk_chunked over [0, n) and checks the ranges it was handed:
+// every boundary but the end is a multiple of qt_cache_line_size, every
+// chunk but the last is exactly qt_chunk_size(n, grain) long, and every
+// index is covered exactly once.
+static void check_chunks(std::size_t n, std::size_t grain) {
+  CAPTURE(n, grain);
+  auto hits = std::make_unique<std::atomic<int>[]>(n + 1);
+  std::atomic<std::size_t> chunks{0};
+  std::atomic<bool> misaligned{false}, missized{false};
+  std::size_t chunk_size = stdexx::qt_chunk_size(n, grain);
+
+  stdexec::sync_wait(
+    stdexec::schedule(stdexx::qthreads_scheduler{}) |
+    stdexx::bulk_chunked(n, grain, [&](std::size_t begin, std::size_t end) {
+      chunks.fetch_add(1);
+      if (begin % stdexx::qt_cache_line_size != 0 ||
+          (end != n && end % stdexx::qt_cache_line_size != 0)) {
+        misaligned.store(true);
+      }
+      if (begin >= end || end > n || (end != n && end - begin != chunk_size)) {
+        missized.store(true);
+      }
+      for (std::size_t i = begin; i < end && i < n; ++i) hits[i].fetch_add(1);
+    }));
+
+  CHECK_FALSE(misaligned.load());
+  CHECK_FALSE(missized.load());
+  CHECK(chunks.load() == (n + chunk_size - 1) / chunk_size);
+  CHECK(chunk_size >= grain);
+  CHECK(chunk_size % stdexx::qt_cache_line_size == 0);
+  std::size_t covered_once = 0;
+  for (std::size_t i = 0; i < n; ++i) covered_once += hits[i].load() == 1;
+  CHECK(covered_once == n);
+}
+
+TEST_CASE("bulk_chunked splits evenly over the workers", "[bulk_chunked]") {
+  for (std::size_t n : {0, 1, 63, 64, 65, 1000, 1 << 20}) {
+    check_chunks(n, 0);
+  }
+}
+
+TEST_CASE("bulk_chunked chunks are at least grain indices",
+          "[bulk_chunked]") {
+  // A grain bigger than the even split caps the number of chunks, and
+  // gets rounded up to whole cache lines.
+  check_chunks(10000, 4096);
+  check_chunks(10000, 100);
+  check_chunks(100, 1000);
+}
+
+auto main(int argc, char *argv[]) -> int {
+  stdexx::init();
+  int result = Catch::Session().run(argc, argv);
+  stdexx::finalize();
+  return result;
+}
+
+#elif (STDEXX_ARGOBOTS)
+
+auto main() -> int {} // todo
+
+#elif (STDEXX_REFERENCE)
+
+auto main() -> int {}
+
+#else
+error "Not implemented."
+#endif
@@ -0,0 +1,45 @@
+#include <atomic>
+#include <cstdio>
+#include <iostream>
+
+#include <stdexx.hpp>
+
+#if (STDEXX_QTHREADS)
+
+static std::atomic<aligned_t> total{0};
+
+static void background_work(aligned_t i) { total += i; }
+
+static aligned_t answer() { return 42; }
+
+auto main() -> int {
+  stdexx::runtime rt;
+
+  // At most 64 tasks in flight at a time, spawn yields once that's hit.
+  stdexx::counting_scope scope{64};
+
+  for (aligned_t i = 0; i < 10000; ++i) {
+    scope.spawn(stdexx::qthreads_func_sender(&background_work, i));
+  }
+  auto fut = scope.spawn_future(stdexx::qthreads_basic_func_sender(&answer));
+
+  auto [v] = stdexec::sync_wait(std::move(fut)).value();
+  std::cout << "future got " << v << std::endl;
+
+  // Drain everything before the scope goes away.
+  stdexec::sync_wait(scope.join());
+  std::cout << "background total " << total.load() << std::endl;
+  return 0;
+}
+
+#elif (STDEXX_ARGOBOTS)
+
+auto main() -> int {} // todo
+
+#elif (STDEXX_REFERENCE)
+
+auto main() -> int {}
+
+#else
+error "Not implemented."
+#endif
@@ -52,6 +52,10 @@ auto main() -> int {
   return (a == 42) ? 1 : 0;
 }
 
+#elif (STDEXX_ARGOBOTS)
+
+auto main() -> int {} // todo
+
 #elif (STDEXX_REFERENCE)
 
 struct sender {
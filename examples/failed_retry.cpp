@@ -5,6 +5,10 @@
 
 auto main() -> int {}
 
+#elif (STDEXX_ARGOBOTS)
+
+auto main() -> int {} // todo
+
 #elif (STDEXX_REFERENCE)
 
 struct fail_some {
@@ -0,0 +1,50 @@
+#include <cstdio>
+#include <iostream>
+#include <string>
+
+#include <stdexx.hpp>
+
+#if (STDEXX_QTHREADS)
+
+auto main() -> int {
+  stdexx::runtime rt;
+
+  // The consumer is started first and suspends on the empty word
+  // until the producer fills it.
+  aligned_t word;
+  qthread_empty(&word);
+  auto [doubled] =
+    stdexec::sync_wait(
+      stdexec::when_all(
+        stdexx::feb_read(&word) |
+          stdexec::then([](aligned_t v) { return 2 * v; }),
+        stdexx::feb_write(&word, 21)))
+      .value();
+  std::cout << "consumer got " << doubled << std::endl;
+
+  // Same thing with a payload that doesn't fit in a word, and two
+  // consumers of the same value.
+  stdexx::feb_var<std::string> msg;
+  auto [a, b] =
+    stdexec::sync_wait(
+      stdexec::when_all(
+        msg.read() | stdexec::then([](std::string s) { return s.size(); }),
+        msg.read() | stdexec::then([](std::string s) { return s + "!"; }),
+        msg.write("hello from the producer")))
+      .value();
+  std::cout << "consumers got " << a << " and " << b << std::endl;
+
+  return 0;
+}
+
+#elif (STDEXX_ARGOBOTS)
+
+auto main() -> int {} // todo
+
+#elif (STDEXX_REFERENCE)
+
+auto main() -> int {}
+
+#else
+error "Not implemented."
+#endif
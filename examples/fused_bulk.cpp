@@ -0,0 +1,119 @@
+#include <functional>
+#include <ranges>
+#include <stdexcept>
+#include <vector>
+
+#include <stdexx.hpp>
+
+#if (STDEXX_QTHREADS)
+
+#include <catch2/catch_session.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+// Two element-wise stages of a CG iteration, x += alpha * p and
+// r -= alpha * Ap, followed by r . r. The inputs are small multiples of
+// 1/8, so every square and partial sum is exact and the fused and
+// unfused sums have to agree exactly even though they add in a
+// different order.
+struct cg_update {
+  static constexpr std::size_t n = 100000;
+  static constexpr double alpha = 0.5;
+  std::vector<double> p = std::vector<double>(n);
+  std::vector<double> Ap = std::vector<double>(n);
+  std::vector<double> x = std::vector<double>(n, 1.0);
+  std::vector<double> r = std::vector<double>(n);
+
+  cg_update() {
+    for (std::size_t i = 0; i < n; ++i) {
+      p[i] = double(i % 5);
+      Ap[i] = 0.25 * double(i % 3);
+      r[i] = 1.0 + double(i % 17);
+    }
+  }
+
+  auto update_x() {
+    return [this](std::size_t i) { x[i] += alpha * p[i]; };
+  }
+
+  auto update_r() {
+    return [this](std::size_t i) { r[i] -= alpha * Ap[i]; };
+  }
+};
+
+static void throwing_stage(std::size_t i) {
+  if (i == 4242) throw std::runtime_error("stage failed");
+}
+
+TEST_CASE("fused_bulk matches separate bulks and reduce", "[fused_bulk]") {
+  auto sched = stdexx::qthreads_scheduler{};
+  cg_update unfused, fused;
+  std::size_t const n = cg_update::n;
+
+  stdexec::sync_wait(stdexec::schedule(sched) |
+                     stdexec::bulk(stdexec::par, n, unfused.update_x()) |
+                     stdexec::bulk(stdexec::par, n, unfused.update_r()));
+  auto squares = std::views::iota(std::size_t(0), n) |
+                 std::views::transform([&](std::size_t i) {
+                   return unfused.r[i] * unfused.r[i];
+                 });
+  auto [unfused_sum] =
+    stdexec::sync_wait(stdexx::reduce(sched, squares, 0.0, std::plus<>{}))
+      .value();
+
+  auto [fused_sum] =
+    stdexec::sync_wait(
+      stdexec::schedule(sched) |
+      stdexx::fused_bulk(n, fused.update_x(), fused.update_r())
+        .then_reduce(0.0,
+                     [&](std::size_t i, double &acc) {
+                       acc += fused.r[i] * fused.r[i];
+                     }))
+      .value();
+
+  CHECK(fused.x == unfused.x);
+  CHECK(fused.r == unfused.r);
+  CHECK(fused_sum == unfused_sum);
+}
+
+TEST_CASE("a throwing stage fails fused and unfused bulks alike",
+          "[fused_bulk]") {
+  auto sched = stdexx::qthreads_scheduler{};
+  cg_update t;
+  std::size_t const n = cg_update::n;
+
+  CHECK_THROWS_AS(
+    stdexec::sync_wait(stdexec::schedule(sched) |
+                       stdexec::bulk(stdexec::par, n, t.update_x()) |
+                       stdexec::bulk(stdexec::par, n, &throwing_stage)),
+    std::runtime_error);
+  CHECK_THROWS_AS(
+    stdexec::sync_wait(stdexec::schedule(sched) |
+                       stdexx::fused_bulk(n, t.update_x(), &throwing_stage)),
+    std::runtime_error);
+  CHECK_THROWS_AS(stdexec::sync_wait(
+                    stdexec::schedule(sched) |
+                    stdexx::fused_bulk(n, &throwing_stage)
+                      .then_reduce(0.0, [](std::size_t, double &acc) {
+                        acc += 1.0;
+                      })),
+                  std::runtime_error);
+}
+
+auto main(int argc, char *argv[]) -> int {
+  stdexx::init();
+  int result = Catch::Session().run(argc, argv);
+  stdexx::finalize();
+  return result;
+}
+
+#elif (STDEXX_ARGOBOTS)
+
+auto main() -> int {} // todo
+
+#elif (STDEXX_REFERENCE)
+
+auto main() -> int {}
+
+#else
+error "Not implemented."
+#endif
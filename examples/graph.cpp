@@ -0,0 +1,110 @@
+#include <chrono>
+#include <stdexcept>
+#include <vector>
+
+#include <stdexx.hpp>
+
+#if (STDEXX_QTHREADS)
+
+#include <catch2/catch_session.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+using namespace std::chrono_literals;
+
+// y = a * x, then sum(y) + 1 into total, then a task that copies total
+// to seen, then one that counts how often the end of the graph ran.
+// Everything is captured by reference, so every replay sees the
+// current values of a and fail.
+struct axpy_graph {
+  static constexpr std::size_t n = 10000;
+  std::vector<double> x = std::vector<double>(n, 1.0);
+  std::vector<double> y = std::vector<double>(n, 0.0);
+  double a = 0.0, total = 0.0, seen = 0.0;
+  bool fail = false;
+  int tails = 0;
+  stdexx::graph g = stdexx::create_graph([this](stdexx::graph_node root) {
+    root.then_bulk(n, [this](std::size_t i) { y[i] = a * x[i]; })
+      .then_reduce(
+        n,
+        1.0,
+        [this](std::size_t i, double &acc) { acc += y[i]; },
+        [this](double sum) { total = sum; })
+      .then([this] {
+        if (fail) throw std::runtime_error("node failed");
+        seen = total;
+      })
+      .then([this] { ++tails; });
+  });
+};
+
+// A node that runs until it's asked to stop, and one after it.
+struct spin_graph {
+  int after_spin = 0;
+  stdexx::graph g = stdexx::create_graph([this](stdexx::graph_node root) {
+    root
+      .then([] {
+        while (!stdexx::stop_requested()) qthread_yield();
+      })
+      .then([this] { ++after_spin; });
+  });
+};
+
+TEST_CASE("graph is captured once and replayed", "[graph]") {
+  axpy_graph t;
+  CHECK(t.g.size() == 5);
+  for (int k = 1; k <= 3; ++k) {
+    t.a = k;
+    stdexec::sync_wait(t.g.submit());
+    // init of the reduce node is added once, not once per chunk.
+    CHECK(t.seen == 1.0 + k * double(axpy_graph::n));
+  }
+  CHECK(t.tails == 3);
+}
+
+TEST_CASE("graph fails with the exception of a node", "[graph]") {
+  axpy_graph t;
+  t.fail = true;
+  CHECK_THROWS_AS(stdexec::sync_wait(t.g.submit()), std::runtime_error);
+  // The nodes after the failed one were skipped.
+  CHECK(t.tails == 0);
+
+  t.fail = false;
+  stdexec::sync_wait(t.g.submit());
+  CHECK(t.tails == 1);
+}
+
+TEST_CASE("stopped graph skips the rest of its nodes", "[graph]") {
+  spin_graph t;
+  stdexx::qthreads_timer timer;
+  stdexec::sync_wait(stdexx::when_any(
+    t.g.submit(), stdexx::schedule_after(timer.get_scheduler(), 10ms)));
+  CHECK(t.after_spin == 0);
+}
+
+TEST_CASE("graph can't be submitted while it's running", "[graph]") {
+  spin_graph t;
+  // The second submission fails, and when_all then stops the first.
+  CHECK_THROWS_AS(
+    stdexec::sync_wait(stdexec::when_all(t.g.submit(), t.g.submit())),
+    std::logic_error);
+  CHECK(t.after_spin == 0);
+}
+
+auto main(int argc, char *argv[]) -> int {
+  stdexx::init();
+  int result = Catch::Session().run(argc, argv);
+  stdexx::finalize();
+  return result;
+}
+
+#elif (STDEXX_ARGOBOTS)
+
+auto main() -> int {} // todo
+
+#elif (STDEXX_REFERENCE)
+
+auto main() -> int {}
+
+#else
+error "Not implemented."
+#endif
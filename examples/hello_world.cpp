@@ -52,6 +52,18 @@ auto main() -> int {
       std::cout << "then after func sender: " << val << std::endl;
     }));
 
+  stdexec::sync_wait(
+    stdexx::qthreads_func_sender(
+      [](int a, double b) { return a * b; }, 2, 1.5) |
+    stdexec::then([](double val) {
+      std::cout << "then after variadic func sender: " << val << std::endl;
+    }));
+
+  stdexec::sync_wait(
+    stdexx::qthreads_func_sender(
+      [](char const *msg) { std::cout << msg << std::endl; },
+      "hello from a func sender returning void"));
+
   stdexec::sync_wait(
     stdexx::qthreads_just_sender(2) | stdexec::then([](auto val) {
       std::cout << "then after just sender: " << val << std::endl;
@@ -67,6 +79,38 @@ auto main() -> int {
   return 0;
 }
 
+#elif (STDEXX_ARGOBOTS)
+
+auto main() -> int {
+  stdexx::init();
+
+  // Basic example:
+  stdexec::sender auto begin = stdexec::schedule(stdexx::argobots_scheduler{});
+  stdexec::sender auto hi_again = stdexec::then(std::move(begin), []() {
+    std::cout << "Hello world! Have an int.\n";
+    return 13;
+  });
+  auto val = stdexec::sync_wait(std::move(hi_again)).value();
+  std::cout << std::get<0>(val) << std::endl;
+
+  // Work that never blocks can run on tasklets instead of ULTs:
+  stdexec::sync_wait(
+    stdexec::schedule(stdexx::argobots_scheduler{ABT_POOL_NULL, true}) |
+    stdexec::then([]() {
+      std::cout << "hello from a then lambda on a tasklet" << std::endl;
+    }));
+
+  // bulk spreads the iterations over the pools of all execution streams:
+  stdexec::sync_wait(
+    stdexec::schedule(stdexx::argobots_scheduler{}) |
+    stdexec::bulk(stdexec::par, 8, [](int i) {
+      std::cout << "hello from bulk (i=" << i << ")" << std::endl;
+    }));
+
+  stdexx::finalize();
+  return 0;
+}
+
 #elif (STDEXX_REFERENCE)
 
 #include "exec/static_thread_pool.hpp"
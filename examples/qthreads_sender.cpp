@@ -97,14 +97,16 @@ struct sender_wrapper_receiver {
 };
 
 auto main() -> int {
+  stdexx::runtime rt;
+
   /*Explicit use of custom senders*/
   stdexx::qthreads_context qthreads_context;
   stdexec::sender auto s1 =
     then(stdexec::just(42), qthreads_context, sender_wrapper{task1, 0});
   stdexec::sender auto s2 =
     then(stdexec::just(42), qthreads_context, sender_wrapper{task2, 0});
-  auto val = stdexec::sync_wait(stdexec::when_all(s1, s2)).value();
-  // std::cout << std::get<0>(val) << std::endl;
+  auto [val1, val2] = stdexec::sync_wait(stdexec::when_all(s1, s2)).value();
+  std::cout << val1 << " " << val2 << std::endl;
 
   // Using sender_wrapper and sender_wrapper_receiver
   stdexec::sender auto s5 = sender_wrapper{task3};
@@ -120,6 +122,10 @@ auto main() -> int {
   return 0;
 }
 
+#elif (STDEXX_ARGOBOTS)
+
+auto main() -> int {} // todo
+
 #elif (STDEXX_REFERENCE)
 
 auto main() -> int {}
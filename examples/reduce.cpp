@@ -0,0 +1,68 @@
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include <stdexx.hpp>
+
+#if (STDEXX_QTHREADS)
+
+#include <catch2/catch_session.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+// Float sums of values this far apart depend on the order they're added
+// in, so a reduction that combined partials in whatever order the
+// workers finished would differ from run to run.
+static std::vector<float> spread_values() {
+  std::vector<float> values(1 << 20);
+  for (std::size_t i = 0; i < values.size(); ++i) {
+    values[i] = std::ldexp(1.0f + float(i % 7), int(i % 41) - 20) *
+                (i % 3 ? 1.0f : -1.0f);
+  }
+  return values;
+}
+
+static float sum(std::vector<float> const &values, float init) {
+  auto [s] = stdexec::sync_wait(stdexx::reduce(stdexx::qthreads_scheduler{},
+                                               values,
+                                               init,
+                                               std::plus<>{}))
+               .value();
+  return s;
+}
+
+TEST_CASE("float reduce is bitwise reproducible", "[reduce]") {
+  auto values = spread_values();
+  float first = sum(values, 0.0f);
+  float second = sum(values, 0.0f);
+  CHECK(std::bit_cast<std::uint32_t>(first) ==
+        std::bit_cast<std::uint32_t>(second));
+}
+
+TEST_CASE("reduce folds init in once", "[reduce]") {
+  auto values = spread_values();
+  float plain = sum(values, 0.0f);
+  float shifted = sum(values, 1.0f);
+  CHECK(std::bit_cast<std::uint32_t>(shifted) ==
+        std::bit_cast<std::uint32_t>(1.0f + plain));
+}
+
+auto main(int argc, char *argv[]) -> int {
+  stdexx::init();
+  int result = Catch::Session().run(argc, argv);
+  stdexx::finalize();
+  return result;
+}
+
+#elif (STDEXX_ARGOBOTS)
+
+auto main() -> int {} // todo
+
+#elif (STDEXX_REFERENCE)
+
+auto main() -> int {}
+
+#else
+error "Not implemented."
+#endif
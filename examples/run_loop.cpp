@@ -7,6 +7,10 @@ using namespace std::literals;
 
 auto main() -> int {} // todo
 
+#elif (STDEXX_ARGOBOTS)
+
+auto main() -> int {} // todo
+
 #elif (STDEXX_REFERENCE)
 
 int main() {
@@ -0,0 +1,45 @@
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+
+#include <stdexx.hpp>
+
+#if (STDEXX_QTHREADS)
+
+auto main() -> int {
+  // Small stacks and a single shepherd for a short-lived job made of
+  // lots of tiny tasks.
+  stdexx::runtime_config cfg;
+  cfg.num_shepherds = 1;
+  cfg.stack_size = 64 * 1024;
+  cfg.affinity = true;
+  cfg.prewarm = true;
+
+  stdexx::runtime rt{cfg};
+  using us = std::chrono::duration<double, std::micro>;
+  std::cout << "qthreads started in " << us(rt.startup_time()).count()
+            << " us with " << rt.num_shepherds() << " shepherd(s), "
+            << rt.num_workers() << " worker(s) and " << rt.stack_size()
+            << " byte stacks" << std::endl;
+  std::cout << "pre-warming stacks took " << us(rt.prewarm_time()).count()
+            << " us" << std::endl;
+
+  auto [v] =
+    stdexec::sync_wait(stdexec::schedule(rt.get_scheduler()) |
+                       stdexec::then([] { return 42; }))
+      .value();
+  std::cout << "got " << v << std::endl;
+  return 0;
+}
+
+#elif (STDEXX_ARGOBOTS)
+
+auto main() -> int {} // todo
+
+#elif (STDEXX_REFERENCE)
+
+auto main() -> int {}
+
+#else
+error "Not implemented."
+#endif
@@ -0,0 +1,55 @@
+#include <cstdio>
+#include <iostream>
+#include <numeric>
+#include <vector>
+
+#include <stdexx.hpp>
+
+#if (STDEXX_QTHREADS)
+
+// Stand-in for an expensive intermediate result, e.g. a factorization.
+static std::vector<double> factorize(std::size_t n) {
+  std::cout << "factorizing once" << std::endl;
+  std::vector<double> lu(n);
+  std::iota(lu.begin(), lu.end(), 1.0);
+  return lu;
+}
+
+auto main() -> int {
+  stdexx::runtime rt;
+
+  // The factorization runs once no matter how many chains use it.
+  auto lu = stdexx::qthreads_func_sender(&factorize, std::size_t{1000}) |
+            stdexec::split();
+  auto solve = [](double scale) {
+    return [scale](std::vector<double> lu) {
+      return scale * std::accumulate(lu.begin(), lu.end(), 0.0);
+    };
+  };
+  auto [a, b, c] =
+    stdexec::sync_wait(stdexec::when_all(lu | stdexec::then(solve(1.0)),
+                                         lu | stdexec::then(solve(2.0)),
+                                         lu | stdexec::then(solve(3.0))))
+      .value();
+  std::cout << a << " " << b << " " << c << std::endl;
+
+  // ensure_started kicks the work off right away, the result is
+  // picked up later.
+  auto eager = stdexec::ensure_started(
+    stdexx::qthreads_func_sender(&factorize, std::size_t{10}));
+  auto [v] = stdexec::sync_wait(std::move(eager)).value();
+  std::cout << "eager result has " << v.size() << " entries" << std::endl;
+  return 0;
+}
+
+#elif (STDEXX_ARGOBOTS)
+
+auto main() -> int {} // todo
+
+#elif (STDEXX_REFERENCE)
+
+auto main() -> int {}
+
+#else
+error "Not implemented."
+#endif
@@ -5,6 +5,10 @@
 
 auto main() -> int {} // todo
 
+#elif (STDEXX_ARGOBOTS)
+
+auto main() -> int {} // todo
+
 #elif (STDEXX_REFERENCE)
 int main() {
   // Declare a pool of 3 worker threads:
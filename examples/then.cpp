@@ -6,6 +6,10 @@
 
 auto main() -> int {} // todo
 
+#elif (STDEXX_ARGOBOTS)
+
+auto main() -> int {} // todo
+
 #elif (STDEXX_REFERENCE)
 int main() {
   auto x = stdexx::then(stdexx::just(42), [](int i) {
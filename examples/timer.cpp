@@ -0,0 +1,66 @@
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+
+#include <stdexx.hpp>
+
+#if (STDEXX_QTHREADS)
+
+using namespace std::chrono_literals;
+
+static int attempts = 0;
+
+// Stand-in for a call to a flaky service, fails twice before answering.
+static bool try_request() { return ++attempts >= 3; }
+
+// Stand-in for a request that never answers on its own.
+static void hanging_request() {
+  while (!stdexx::stop_requested()) qthread_yield();
+}
+
+auto main() -> int {
+  stdexx::runtime rt;
+  stdexx::qthreads_timer timer;
+  auto sched = timer.get_scheduler();
+
+  // Retry with exponential backoff. The wait between attempts is a
+  // timer in the wheel, it doesn't hold on to a worker.
+  auto backoff = 1ms;
+  auto start = sched.now();
+  while (true) {
+    auto [ok] = stdexec::sync_wait(stdexec::let_value(
+                                     stdexx::schedule_after(sched, backoff),
+                                     [] {
+                                       return stdexx::qthreads_func_sender(
+                                         &try_request);
+                                     }))
+                  .value();
+    if (ok) break;
+    backoff *= 2;
+  }
+  auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+    sched.now() - start);
+  std::cout << "succeeded after " << attempts << " attempts in "
+            << elapsed.count() << "us" << std::endl;
+
+  // Timeout: whichever finishes first wins, and the loser is stopped.
+  // Had the request answered first, the pending timer would have been
+  // taken out of the wheel instead.
+  stdexec::sync_wait(
+    stdexx::when_any(stdexx::qthreads_func_sender(&hanging_request),
+                     stdexx::schedule_after(sched, 10ms)));
+  std::cout << "request timed out" << std::endl;
+  return 0;
+}
+
+#elif (STDEXX_ARGOBOTS)
+
+auto main() -> int {} // todo
+
+#elif (STDEXX_REFERENCE)
+
+auto main() -> int {}
+
+#else
+error "Not implemented."
+#endif
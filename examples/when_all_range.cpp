@@ -0,0 +1,42 @@
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <stdexx.hpp>
+
+#if (STDEXX_QTHREADS)
+
+static aligned_t square(aligned_t x) { return x * x; }
+
+auto main(int argc, char *argv[]) -> int {
+  stdexx::runtime rt;
+
+  // Number of children only known at runtime.
+  std::size_t n = argc > 1 ? std::stoul(argv[1]) : 1000;
+  std::vector<stdexx::qthreads_func_sender<decltype(&square), aligned_t>>
+    children;
+  children.reserve(n);
+  for (std::size_t i = 0; i < n; ++i) {
+    children.emplace_back(&square, static_cast<aligned_t>(i));
+  }
+
+  auto [squares] =
+    stdexec::sync_wait(stdexx::when_all_range(std::move(children))).value();
+  aligned_t sum = 0;
+  for (aligned_t v : squares) sum += v;
+  std::cout << "sum of the first " << n << " squares: " << sum << std::endl;
+  return 0;
+}
+
+#elif (STDEXX_ARGOBOTS)
+
+auto main() -> int {} // todo
+
+#elif (STDEXX_REFERENCE)
+
+auto main() -> int {}
+
+#else
+error "Not implemented."
+#endif
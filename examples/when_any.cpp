@@ -0,0 +1,46 @@
+#include <cstdio>
+#include <iostream>
+
+#include <stdexx.hpp>
+
+#if (STDEXX_QTHREADS)
+
+// Stand-in for a replica of a request that takes a given amount of work.
+// Gives up early once another replica has already answered.
+static aligned_t replica(aligned_t iterations) {
+  for (aligned_t i = 0; i < iterations; ++i) {
+    if (stdexx::stop_requested()) return 0;
+  }
+  return iterations;
+}
+
+auto main() -> int {
+  stdexx::init();
+
+  // Hedged request: the same work is sent to three replicas and
+  // the first answer wins. The other two are asked to stop.
+  auto [winner] =
+    stdexec::sync_wait(
+      stdexx::when_any(
+        stdexx::qthreads_func_sender(&replica, aligned_t{1000000000}),
+        stdexx::qthreads_func_sender(&replica, aligned_t{1000}),
+        stdexx::qthreads_func_sender(&replica, aligned_t{100000000})))
+      .value();
+  std::cout << "first replica to answer did " << winner << " iterations"
+            << std::endl;
+
+  stdexx::finalize();
+  return 0;
+}
+
+#elif (STDEXX_ARGOBOTS)
+
+auto main() -> int {} // todo
+
+#elif (STDEXX_REFERENCE)
+
+auto main() -> int {}
+
+#else
+error "Not implemented."
+#endif
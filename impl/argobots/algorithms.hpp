@@ -0,0 +1,6 @@
+#pragma once
+
+#include <reference/algorithms/retry.hpp>
+#include <reference/algorithms/then.hpp>
+#include <reference/common_recv/expect_recv.hpp>
+
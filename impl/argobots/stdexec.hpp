@@ -0,0 +1,656 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <atomic>
+#include <concepts>
+#include <exception>
+#include <optional>
+#include <system_error>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <stdexec/execution.hpp>
+
+#include <abt.h>
+
+namespace stdexx {
+
+// Execution streams and pools created by init().
+// Each execution stream gets its own pool, and its scheduler pops from
+// all pools starting with its own, so idle streams steal from busy ones.
+struct argobots_runtime {
+  std::vector<ABT_xstream> xstreams;
+  std::vector<ABT_pool> pools;
+};
+
+inline argobots_runtime abt_runtime{};
+
+// Number of execution streams defaults to STDEXX_NUM_XSTREAMS if set,
+// otherwise to the hardware concurrency.
+int init(int num_xstreams = 0) {
+  if (num_xstreams <= 0) {
+    char const *env = getenv("STDEXX_NUM_XSTREAMS");
+    num_xstreams = env ? atoi(env) : 0;
+  }
+  if (num_xstreams <= 0) {
+    num_xstreams = static_cast<int>(std::thread::hardware_concurrency());
+  }
+  if (num_xstreams <= 0) num_xstreams = 1;
+
+  int r = ABT_init(0, NULL);
+  if (r != ABT_SUCCESS) return r;
+
+  auto &rt = abt_runtime;
+  rt.xstreams.resize(num_xstreams);
+  rt.pools.resize(num_xstreams);
+  for (int i = 0; i < num_xstreams; ++i) {
+    r = ABT_pool_create_basic(
+      ABT_POOL_FIFO, ABT_POOL_ACCESS_MPMC, ABT_TRUE, &rt.pools[i]);
+    if (r != ABT_SUCCESS) return r;
+  }
+
+  // Rotate the pool list so every stream looks at its own pool first.
+  std::vector<ABT_pool> order(num_xstreams);
+  for (int i = 0; i < num_xstreams; ++i) {
+    for (int k = 0; k < num_xstreams; ++k) {
+      order[k] = rt.pools[(i + k) % num_xstreams];
+    }
+    if (i == 0) {
+      ABT_xstream_self(&rt.xstreams[0]);
+      r = ABT_xstream_set_main_sched_basic(
+        rt.xstreams[0], ABT_SCHED_DEFAULT, num_xstreams, order.data());
+    } else {
+      r = ABT_xstream_create_basic(ABT_SCHED_DEFAULT,
+                                   num_xstreams,
+                                   order.data(),
+                                   ABT_SCHED_CONFIG_NULL,
+                                   &rt.xstreams[i]);
+    }
+    if (r != ABT_SUCCESS) return r;
+  }
+  return ABT_SUCCESS;
+}
+
+void finalize() {
+  auto &rt = abt_runtime;
+  for (std::size_t i = 1; i < rt.xstreams.size(); ++i) {
+    ABT_xstream_join(rt.xstreams[i]);
+    ABT_xstream_free(&rt.xstreams[i]);
+  }
+  rt.xstreams.clear();
+  rt.pools.clear();
+  ABT_finalize();
+}
+
+// Pool owned by the execution stream running the caller.
+// Falls back to the first pool for callers outside of Argobots.
+inline ABT_pool current_pool() noexcept {
+  int rank = 0;
+  if (ABT_xstream_self_rank(&rank) != ABT_SUCCESS ||
+      rank >= static_cast<int>(abt_runtime.pools.size())) {
+    rank = 0;
+  }
+  return abt_runtime.pools[rank];
+}
+
+struct argobots_domain;
+struct argobots_scheduler;
+struct argobots_env;
+
+struct argobots_sender_tag : stdexec::sender_t {};
+
+template <typename S>
+concept is_argobots_sender =
+  std::derived_from<typename S::sender_concept, argobots_sender_tag>;
+
+template <typename Der>
+struct argobots_base_sender;
+struct argobots_sender;
+
+template <class Tag, class... Env>
+struct transform_sender_for;
+
+template <class Tag>
+struct apply_sender_for;
+
+// Whether the domain has a transform for a sender expression, i.e. a
+// transform_sender_for specialization for its tag that accepts its
+// children. Everything else, e.g. when_all, starts_on, let_value or
+// split, isn't customized here and falls through to stdexec's default
+// lowering instead of failing to compile.
+template <class T>
+concept abt_complete_type = requires { sizeof(T); };
+
+template <class Sender, class... Env>
+concept abt_transformable =
+  abt_complete_type<
+    transform_sender_for<stdexec::tag_of_t<Sender>, Env...>> &&
+  requires(Sender &&sndr, Env const &...env) {
+    stdexec::__sexpr_apply(
+      static_cast<Sender &&>(sndr),
+      transform_sender_for<stdexec::tag_of_t<Sender>, Env...>{env...});
+  };
+
+// Same structure as qthreads_domain, see there for the details.
+struct argobots_domain {
+  template <stdexec::sender_expr Sender, class... Env>
+    requires abt_transformable<Sender, Env...>
+  auto transform_sender(Sender &&sndr, Env const &...env) const {
+    using Tag = stdexec::tag_of_t<Sender>;
+    return stdexec::__sexpr_apply(static_cast<Sender &&>(sndr),
+                                  transform_sender_for<Tag, Env...>{env...});
+  }
+
+  template <typename Sn, typename... Env>
+    requires is_argobots_sender<Sn>
+  auto &&transform_sender(Sn &&sndr, Env const &...env) const noexcept;
+
+  template <class Tag, stdexec::sender Sender, class... Args>
+    requires stdexec::__callable<apply_sender_for<Tag>, Sender, Args...>
+  static auto apply_sender(Tag, Sender &&sndr, Args &&...args) {
+    return apply_sender_for<Tag>{}(static_cast<Sender &&>(sndr),
+                                   static_cast<Args &&>(args)...);
+  }
+};
+
+// Scheduler that pushes work into an Argobots pool.
+// With the default null pool the work goes to the pool of the execution
+// stream running the caller. Setting tasklet forks ABT tasklets instead
+// of ULTs. Tasklets are cheaper to create but have no stack of their own,
+// so nothing that runs on them may block (e.g. sync_wait or bulk).
+struct argobots_scheduler {
+  ABT_pool pool = ABT_POOL_NULL;
+  bool tasklet = false;
+
+  friend argobots_domain tag_invoke(stdexec::get_domain_t const,
+                                    argobots_scheduler const &) noexcept;
+
+  bool operator==(argobots_scheduler const &rhs) const noexcept {
+    return pool == rhs.pool && tasklet == rhs.tasklet;
+  }
+
+  bool operator!=(argobots_scheduler const &rhs) const noexcept {
+    return !(*this == rhs);
+  }
+
+  argobots_sender schedule() const noexcept;
+};
+
+// One scheduler per pool, indexed by execution stream rank.
+std::vector<argobots_scheduler> pool_schedulers(bool tasklet = false) {
+  std::vector<argobots_scheduler> scheds;
+  scheds.reserve(abt_runtime.pools.size());
+  for (ABT_pool pool : abt_runtime.pools) scheds.push_back({pool, tasklet});
+  return scheds;
+}
+
+// CRTP type used by the various operation states.
+// Equivalent of qt_os_base: start() creates a ULT (or tasklet) running
+// Derived_Op_State::task. Completion is signaled through the receiver.
+template <typename Derived_Op_State, typename Receiver>
+struct abt_os_base {
+  Receiver receiver;
+  ABT_pool pool;
+  bool tasklet;
+
+  template <typename Receiver_>
+  abt_os_base(Receiver_ &&r,
+              ABT_pool pool_ = ABT_POOL_NULL,
+              bool tasklet_ = false):
+    receiver(std::forward<Receiver_>(r)), pool(pool_), tasklet(tasklet_) {}
+
+  abt_os_base(abt_os_base &&) = delete;
+  abt_os_base(abt_os_base const &) = delete;
+  abt_os_base &operator=(abt_os_base &&) = delete;
+  abt_os_base &operator=(abt_os_base const &) = delete;
+
+  inline void start() noexcept {
+    auto st = stdexec::get_stop_token(stdexec::get_env(receiver));
+    if (st.stop_requested()) {
+      stdexec::set_stopped(std::move(receiver));
+      return;
+    }
+    ABT_pool target = pool == ABT_POOL_NULL ? current_pool() : pool;
+    int r =
+      tasklet
+        ? ABT_task_create(target, &Derived_Op_State::task, this, NULL)
+        : ABT_thread_create(
+            target, &Derived_Op_State::task, this, ABT_THREAD_ATTR_NULL, NULL);
+
+    if (r != ABT_SUCCESS) {
+      stdexec::set_error(std::move(this->receiver), r);
+    }
+  }
+};
+
+// Operation state for the sender returned by stdexec::schedule.
+template <typename Receiver>
+struct abt_operation_state :
+  abt_os_base<abt_operation_state<Receiver>, Receiver> {
+  static void task(void *arg) noexcept {
+    auto *os = static_cast<abt_operation_state *>(arg);
+    stdexec::set_value(std::move(os->receiver));
+  }
+};
+
+struct argobots_env {
+  friend argobots_domain tag_invoke(stdexec::get_domain_t const,
+                                    argobots_env const &) noexcept;
+};
+
+// CRTP base class for the Argobots sender types.
+template <typename derived_argobots_sender>
+struct argobots_base_sender {
+  using sender_concept = argobots_sender_tag;
+
+  argobots_env get_env() const noexcept { return {}; }
+};
+
+// Sender type returned by stdexec::schedule(argobots_scheduler).
+struct argobots_sender : argobots_base_sender<argobots_sender> {
+  ABT_pool pool;
+  bool tasklet;
+
+  using completion_signatures =
+    stdexec::completion_signatures<stdexec::set_value_t(),
+                                   stdexec::set_stopped_t(),
+                                   stdexec::set_error_t(int)>;
+
+  template <typename Receiver>
+  abt_operation_state<Receiver> connect(Receiver &&receiver) && {
+    return {{std::forward<Receiver>(receiver), pool, tasklet}};
+  }
+};
+
+argobots_sender argobots_scheduler::schedule() const noexcept {
+  return {{}, pool, tasklet};
+}
+
+// A helper type for our implementation of stdexec::then.
+// The example implementation of then in the stdexec repo
+// doesn't actually handle void return types correctly
+// in its templating idioms.
+// On the other hand, the actual implementation for stdexec::then
+// has a bunch of internal interface calls instead of just
+// using specified ones. This struct type exists as a templating
+// tool so we can compile the associated set_value call
+// after we've determined whether the invocable passed to
+// then returns void.
+template <bool returns_void>
+struct set_value_impl;
+
+template <>
+struct set_value_impl<true> {
+  template <typename Rec, typename Func, typename... Args>
+  static decltype(auto) impl(Rec &&rec, Func &&func, Args &&...args) {
+    std::invoke(std::move(func), static_cast<Args &&>(args)...);
+    stdexec::set_value(std::move(rec));
+  }
+};
+
+template <>
+struct set_value_impl<false> {
+  template <typename Rec, typename Func, typename... Args>
+  static decltype(auto) impl(Rec &&rec, Func &&func, Args &&...args) {
+    return stdexec::set_value(
+      std::move(rec),
+      std::invoke(static_cast<Func &&>(func), static_cast<Args &&>(args)...));
+  }
+};
+
+// Another helper type to generate the completion signatures
+// depending on whether the invocable passed to our "then" customization
+// returns void or not.
+template <bool returns_void>
+struct then_completions;
+
+template <>
+struct then_completions<true> {
+  template <typename ret_t, typename... Args>
+  using completions =
+    stdexec::completion_signatures<stdexec::set_value_t(),
+                                   stdexec::set_error_t(std::exception_ptr)>;
+};
+
+template <>
+struct then_completions<false> {
+  template <typename ret_t, typename... Args>
+  using completions =
+    stdexec::completion_signatures<stdexec::set_value_t(ret_t),
+                                   stdexec::set_error_t(std::exception_ptr)>;
+};
+
+// Sender and receiver types for our customization of stdexec::then.
+// Adapted from the then implementation in their examples directory.
+template <class R, class F>
+class argobots_then_receiver :
+  public stdexec::receiver_adaptor<argobots_then_receiver<R, F>, R> {
+  template <class... As>
+  using ret_t =
+    std::invoke_result_t<decltype(std::move(std::declval<F>())), As...>;
+  template <typename... As>
+  using _completions = then_completions<std::is_same_v<ret_t<As...>, void>>::
+    template completions<ret_t<As...>, As...>;
+public:
+  argobots_then_receiver(R r, F f_):
+    stdexec::receiver_adaptor<argobots_then_receiver, R>{std::move(r)},
+    f(std::move(f_)) {}
+
+  // Customize set_value by invoking the callable and passing the result to the
+  // inner receiver
+  template <class... As>
+    requires stdexec::receiver_of<R, _completions<As...>>
+  void set_value(As &&...as) && noexcept {
+    try {
+      set_value_impl<std::is_same_v<ret_t<As...>, void>>::impl(
+        std::move(*this).base(), std::move(f), static_cast<As &&>(as)...);
+    } catch (...) {
+      stdexec::set_error(std::move(*this).base(), std::current_exception());
+    }
+  }
+private:
+  F f;
+};
+
+template <stdexec::sender S, typename F>
+struct argobots_then_sender : argobots_base_sender<argobots_then_sender<S, F>> {
+  S s;
+  F f;
+
+  template <typename... Args>
+  using ret_t = std::invoke_result_t<F, Args...>;
+
+  // The idiom used in the existing stdexec then example algorithm
+  // doesn't handle the void case in how it calls in to
+  // transform_completion_signatures_of. This is a workaround for that.
+  // TODO: is there a more graceful way to do this?
+  template <bool is_void, typename... Args>
+  struct set_value_signatures;
+
+  template <typename... Args>
+  struct set_value_signatures<true, Args...> {
+    using type = stdexec::completion_signatures<stdexec::set_value_t()>;
+  };
+
+  template <typename... Args>
+  struct set_value_signatures<false, Args...> {
+    using type =
+      stdexec::completion_signatures<stdexec::set_value_t(ret_t<Args...>)>;
+  };
+
+  template <typename... Args>
+  using set_value_t =
+    set_value_signatures<std::is_same_v<ret_t<Args...>, void>, Args...>::type;
+
+  template <class Env>
+  using completions_t = stdexec::transform_completion_signatures_of<
+    S,
+    Env,
+    stdexec::completion_signatures<stdexec::set_error_t(std::exception_ptr)>,
+    set_value_t>;
+
+  template <class Env>
+  auto get_completion_signatures(Env &&) && -> completions_t<Env> {
+    return {};
+  }
+
+  // Connect:
+  template <stdexec::receiver R>
+    requires stdexec::sender_to<S, argobots_then_receiver<R, F>>
+  auto connect(R r) && {
+    // No additional data needed in the operation state, so just
+    // connect the wrapped sender to the argobots_then_receiver which
+    // actually wraps the provided function.
+    return stdexec::connect(
+      std::move(s),
+      argobots_then_receiver<R, F>{static_cast<R &&>(r), static_cast<F &&>(f)});
+  }
+};
+
+// Our transform_sender override calls into this for implementing stdexec::then.
+template <>
+struct transform_sender_for<stdexec::then_t> {
+  template <class Fn, class Sender>
+    requires is_argobots_sender<Sender>
+  auto operator()(stdexec::__ignore, Fn fun, Sender &&sndr) const {
+    // fun is already the invocable we want to wrap.
+    // It's already been extracted from inside the default "then".
+    // All we need to do here is construct the associated sender from it.
+    return argobots_then_sender<Sender, Fn>{
+      {}, static_cast<Sender &&>(sndr), static_cast<Fn &&>(fun)};
+  }
+};
+
+// State shared by all the chunks of a single bulk invocation.
+template <typename Shape, typename F, typename... As>
+struct argobots_bulk_loop {
+  F &f;
+  std::tuple<As &...> args;
+  Shape shape;
+  std::size_t nchunks;
+  std::atomic<bool> failed{false};
+  std::exception_ptr error{};
+
+  struct chunk_arg {
+    argobots_bulk_loop *loop;
+    std::size_t index;
+  };
+
+  static void chunk(void *arg) {
+    auto *c = static_cast<chunk_arg *>(arg);
+    auto *loop = c->loop;
+    std::size_t n = static_cast<std::size_t>(loop->shape);
+    std::size_t begin = n * c->index / loop->nchunks;
+    std::size_t end = n * (c->index + 1) / loop->nchunks;
+    try {
+      std::apply(
+        [&](As &...as) {
+          for (std::size_t i = begin; i < end; ++i) {
+            loop->f(static_cast<Shape>(i), as...);
+          }
+        },
+        loop->args);
+    } catch (...) {
+      if (!loop->failed.exchange(true)) {
+        loop->error = std::current_exception();
+      }
+    }
+  }
+};
+
+// Receiver for our customization of stdexec::bulk.
+// The iteration space is cut into one contiguous chunk per pool and each
+// chunk is pushed as a ULT onto its pool, so every execution stream gets
+// a share. The calling ULT then joins all of them before forwarding the
+// values. If the caller is a tasklet, the joins busy-wait instead.
+template <class R, class Shape, class F>
+class argobots_bulk_receiver :
+  public stdexec::receiver_adaptor<argobots_bulk_receiver<R, Shape, F>, R> {
+public:
+  argobots_bulk_receiver(R r, Shape shape_, F f_):
+    stdexec::receiver_adaptor<argobots_bulk_receiver, R>{std::move(r)},
+    shape(shape_), f(std::move(f_)) {}
+
+  template <class... As>
+  void set_value(As &&...as) && noexcept {
+    auto &pools = abt_runtime.pools;
+    std::size_t nchunks = std::min<std::size_t>(
+      pools.size(), static_cast<std::size_t>(std::max(shape, Shape(0))));
+    argobots_bulk_loop<Shape, F, std::remove_reference_t<As>...> loop{
+      f, {as...}, shape, nchunks};
+    using loop_t = decltype(loop);
+
+    int r = ABT_SUCCESS;
+    try {
+      std::vector<typename loop_t::chunk_arg> chunk_args(nchunks);
+      std::vector<ABT_thread> threads(nchunks, ABT_THREAD_NULL);
+      for (std::size_t i = 0; i < nchunks && r == ABT_SUCCESS; ++i) {
+        chunk_args[i] = {&loop, i};
+        r = ABT_thread_create(pools[i],
+                              &loop_t::chunk,
+                              &chunk_args[i],
+                              ABT_THREAD_ATTR_NULL,
+                              &threads[i]);
+      }
+      for (auto &t : threads) {
+        if (t != ABT_THREAD_NULL) ABT_thread_free(&t);
+      }
+    } catch (...) {
+      stdexec::set_error(std::move(*this).base(), std::current_exception());
+      return;
+    }
+
+    if (r != ABT_SUCCESS) {
+      stdexec::set_error(std::move(*this).base(), r);
+    } else if (loop.failed.load()) {
+      stdexec::set_error(std::move(*this).base(), std::move(loop.error));
+    } else {
+      stdexec::set_value(std::move(*this).base(), static_cast<As &&>(as)...);
+    }
+  }
+private:
+  Shape shape;
+  F f;
+};
+
+template <stdexec::sender S, typename Shape, typename F>
+struct argobots_bulk_sender :
+  argobots_base_sender<argobots_bulk_sender<S, Shape, F>> {
+  S s;
+  Shape shape;
+  F f;
+
+  template <class Env>
+  using completions_t = stdexec::transform_completion_signatures_of<
+    S,
+    Env,
+    stdexec::completion_signatures<stdexec::set_error_t(std::exception_ptr),
+                                   stdexec::set_error_t(int)>>;
+
+  template <class Env>
+  auto get_completion_signatures(Env &&) && -> completions_t<Env> {
+    return {};
+  }
+
+  template <stdexec::receiver R>
+    requires stdexec::sender_to<S, argobots_bulk_receiver<R, Shape, F>>
+  auto connect(R r) && {
+    return stdexec::connect(
+      std::move(s),
+      argobots_bulk_receiver<R, Shape, F>{
+        static_cast<R &&>(r), shape, static_cast<F &&>(f)});
+  }
+};
+
+template <>
+struct transform_sender_for<stdexec::bulk_t> {
+  template <class Data, class Sender>
+    requires is_argobots_sender<Sender>
+  auto operator()(stdexec::__ignore, Data data, Sender &&sndr) const {
+    [[maybe_unused]] auto [policy, shape, fun] = static_cast<Data &&>(data);
+    return argobots_bulk_sender<Sender, decltype(shape), decltype(fun)>{
+      {}, static_cast<Sender &&>(sndr), shape, std::move(fun)};
+  }
+};
+
+// State shared between sync_wait and its receiver.
+// Completion is signaled through an ABT_eventual. When sync_wait is called
+// from a ULT (including the primary one) waiting on it yields the ULT
+// instead of blocking the execution stream.
+template <typename Sn>
+struct argobots_sync_wait_state {
+  ABT_eventual eventual;
+  std::optional<stdexec::__sync_wait::__sync_wait_result_t<Sn>> result{};
+  std::exception_ptr error{};
+
+  argobots_sync_wait_state() noexcept: eventual(ABT_EVENTUAL_NULL) {
+    ABT_eventual_create(0, &eventual);
+  }
+
+  ~argobots_sync_wait_state() { ABT_eventual_free(&eventual); }
+
+  void signal() noexcept { ABT_eventual_set(eventual, NULL, 0); }
+
+  void wait() noexcept { ABT_eventual_wait(eventual, NULL); }
+};
+
+template <typename Sn>
+struct argobots_sync_wait_receiver {
+  using receiver_concept = stdexec::receiver_t;
+  argobots_sync_wait_state<Sn> *state;
+
+  template <class... As>
+  void set_value(As &&...as) noexcept {
+    try {
+      state->result.emplace(static_cast<As &&>(as)...);
+    } catch (...) {
+      state->error = std::current_exception();
+    }
+    state->signal();
+  }
+
+  template <class E>
+  void set_error(E &&e) noexcept {
+    if constexpr (std::is_same_v<std::decay_t<E>, std::exception_ptr>) {
+      state->error = static_cast<E &&>(e);
+    } else if constexpr (std::is_same_v<std::decay_t<E>, std::error_code>) {
+      state->error = std::make_exception_ptr(std::system_error(e));
+    } else {
+      state->error = std::make_exception_ptr(static_cast<E &&>(e));
+    }
+    state->signal();
+  }
+
+  void set_stopped() noexcept { state->signal(); }
+
+  argobots_env get_env() const noexcept { return {}; }
+};
+
+template <>
+struct apply_sender_for<stdexec::sync_wait_t> {
+  template <stdexec::sender Sn>
+  auto operator()(Sn &&sn) const {
+    argobots_sync_wait_state<Sn> state{};
+
+    [[maybe_unused]]
+    auto op = stdexec::connect(static_cast<Sn &&>(sn),
+                               argobots_sync_wait_receiver<Sn>{&state});
+    stdexec::start(op);
+
+    state.wait();
+    if (state.error) std::rethrow_exception(std::move(state.error));
+    return std::move(state.result);
+  }
+};
+
+// Base case for transform_sender.
+template <typename Sn, typename... Env>
+  requires is_argobots_sender<Sn>
+auto &&argobots_domain::transform_sender(Sn &&sndr,
+                                         Env const &...env) const noexcept {
+  return std::move(sndr);
+}
+
+argobots_domain tag_invoke(stdexec::get_domain_t const,
+                           argobots_scheduler const &) noexcept {
+  return {};
+}
+
+argobots_domain tag_invoke(stdexec::get_domain_t const,
+                           argobots_env const &) noexcept {
+  return {};
+}
+
+template <typename Der>
+argobots_domain tag_invoke(stdexec::get_domain_t const,
+                           argobots_base_sender<Der> const &) noexcept {
+  return {};
+}
+
+} // namespace stdexx
@@ -0,0 +1,187 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <tuple>
+#include <utility>
+
+#include <qthreads/reduce.hpp>
+#include <qthreads/stdexec.hpp>
+
+namespace stdexx {
+
+// Bulk that hands whole ranges to the invocable instead of single
+// indices:
+//
+//   sndr | stdexx::bulk_chunked(n, [=](auto begin, auto end) {
+//     for (auto i = begin; i < end; ++i) z[i] = a * x[i] + y[i];
+//   })
+//
+// With stdexec::bulk the loop over i lives in our chunk function and f
+// is called once per index, so the compiler only sees the body of f.
+// Here the loop is in f, which is one call per chunk and a plain loop
+// the compiler can vectorize.
+//
+// Chunk boundaries are multiples of qt_cache_line_size indices. That's
+// a whole number of cache lines for any element type, so as long as the
+// arrays themselves are cache line aligned no two workers write to the
+// same line. Chunks are at least grain indices, which keeps tiny
+// ranges from being spread over every worker. Like bulk, f gets the
+// values sent by sndr as lvalues after begin and end.
+
+// How [0, n) is split up for bulk_chunked: at most one chunk per worker,
+// each a multiple of qt_cache_line_size indices except for the last one.
+inline std::size_t qt_chunk_size(std::size_t n, std::size_t grain) noexcept {
+  auto round_up = [](std::size_t v) {
+    return (v + qt_cache_line_size - 1) / qt_cache_line_size *
+           qt_cache_line_size;
+  };
+  std::size_t workers = static_cast<std::size_t>(qthread_num_workers());
+  return std::max(round_up(std::max<std::size_t>(grain, 1)),
+                  round_up((n + workers - 1) / workers));
+}
+
+// Per-invocation state for bulk_chunked. qt_loop_balance is run over
+// chunk indices, chunk c covers [c * chunk_size, (c + 1) * chunk_size).
+template <typename Shape, typename F, typename... As>
+struct qthreads_bulk_chunked_loop {
+  F &f;
+  std::size_t n;
+  std::size_t chunk_size;
+  std::tuple<As &...> args;
+  std::atomic<bool> const *stop_flag;
+  std::atomic<bool> failed{false};
+  std::exception_ptr error{};
+
+  static void chunk(size_t begin, size_t end, void *arg) {
+    auto *loop = static_cast<qthreads_bulk_chunked_loop *>(arg);
+    *qt_stop_flag_slot() = loop->stop_flag;
+    try {
+      std::apply(
+        [&](As &...as) {
+          for (size_t c = begin; c < end; ++c) {
+            size_t first = c * loop->chunk_size;
+            size_t last = std::min(loop->n, first + loop->chunk_size);
+            loop->f(static_cast<Shape>(first), static_cast<Shape>(last), as...);
+          }
+        },
+        loop->args);
+    } catch (...) {
+      if (!loop->failed.exchange(true)) {
+        loop->error = std::current_exception();
+      }
+    }
+  }
+};
+
+// Receiver for bulk_chunked, same as the bulk receiver otherwise.
+template <class R, class Shape, class F>
+class qthreads_bulk_chunked_receiver :
+  public stdexec::receiver_adaptor<qthreads_bulk_chunked_receiver<R, Shape, F>,
+                                   R> {
+public:
+  qthreads_bulk_chunked_receiver(R r, Shape shape_, std::size_t grain_, F f_):
+    stdexec::receiver_adaptor<qthreads_bulk_chunked_receiver, R>{
+      std::move(r)},
+    shape(shape_), grain(grain_), f(std::move(f_)) {}
+
+  template <class... As>
+  void set_value(As &&...as) && noexcept {
+    std::size_t n = shape > Shape(0) ? static_cast<std::size_t>(shape) : 0;
+    std::size_t chunk_size = qt_chunk_size(n, grain);
+    qthreads_bulk_chunked_loop<Shape, F, std::remove_reference_t<As>...> loop{
+      f,
+      n,
+      chunk_size,
+      {as...},
+      nullptr};
+    {
+      qt_scoped_stop_flag<R> stop(this->base());
+      loop.stop_flag = stop.get();
+      if (n > 0) {
+        qt_loop_balance(0,
+                        (n + chunk_size - 1) / chunk_size,
+                        &decltype(loop)::chunk,
+                        static_cast<void *>(&loop));
+      }
+    }
+    if (loop.failed.load()) {
+      stdexec::set_error(std::move(*this).base(), std::move(loop.error));
+    } else {
+      stdexec::set_value(std::move(*this).base(), static_cast<As &&>(as)...);
+    }
+  }
+private:
+  Shape shape;
+  std::size_t grain;
+  F f;
+};
+
+template <stdexec::sender S, typename Shape, typename F>
+struct qthreads_bulk_chunked_sender :
+  qthreads_base_sender<qthreads_bulk_chunked_sender<S, Shape, F>> {
+  S s;
+  Shape shape;
+  std::size_t grain;
+  F f;
+
+  template <class Env>
+  using completions_t = stdexec::transform_completion_signatures_of<
+    S,
+    Env,
+    stdexec::completion_signatures<stdexec::set_error_t(std::exception_ptr)>>;
+
+  template <class Env>
+  auto get_completion_signatures(Env &&) && -> completions_t<Env> {
+    return {};
+  }
+
+  template <stdexec::receiver R>
+    requires stdexec::sender_to<S,
+                                qthreads_bulk_chunked_receiver<R, Shape, F>>
+  auto connect(R r) && {
+    return stdexec::connect(
+      std::move(s),
+      qthreads_bulk_chunked_receiver<R, Shape, F>{
+        static_cast<R &&>(r), shape, grain, static_cast<F &&>(f)});
+  }
+};
+
+// Pipeable closure returned by bulk_chunked.
+template <typename Shape, typename F>
+struct bulk_chunked_closure :
+  stdexec::sender_adaptor_closure<bulk_chunked_closure<Shape, F>> {
+  Shape shape;
+  std::size_t grain;
+  F f;
+
+  template <stdexec::sender S>
+  auto operator()(S &&s) const & {
+    return qthreads_bulk_chunked_sender<std::remove_cvref_t<S>, Shape, F>{
+      {}, static_cast<S &&>(s), shape, grain, f};
+  }
+
+  template <stdexec::sender S>
+  auto operator()(S &&s) && {
+    return qthreads_bulk_chunked_sender<std::remove_cvref_t<S>, Shape, F>{
+      {}, static_cast<S &&>(s), shape, grain, std::move(f)};
+  }
+};
+
+// Runs f(begin, end, values...) over [0, shape) in chunks of at least
+// grain indices, see above.
+template <typename Shape, typename F>
+auto bulk_chunked(Shape shape, std::size_t grain, F &&f) {
+  return bulk_chunked_closure<Shape, std::decay_t<F>>{
+    {}, shape, grain, std::forward<F>(f)};
+}
+
+// Same, splitting [0, shape) evenly over the workers.
+template <typename Shape, typename F>
+auto bulk_chunked(Shape shape, F &&f) {
+  return bulk_chunked(shape, 0, std::forward<F>(f));
+}
+
+} // namespace stdexx
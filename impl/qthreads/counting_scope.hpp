@@ -0,0 +1,421 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <limits>
+#include <new>
+
+#include <qthreads/stdexec.hpp>
+
+#include <qthread/qpool.h>
+
+namespace stdexx {
+
+class counting_scope;
+
+template <typename Sender>
+struct scope_spawn_op;
+
+template <typename Sender>
+struct scope_future_state;
+
+template <typename Sender>
+struct qthreads_scope_future_sender;
+
+struct qthreads_scope_join_sender;
+
+template <typename Receiver>
+struct scope_join_operation_state;
+
+// Async scope for fire-and-forget work on qthreads.
+// spawn() connects and starts a sender without anyone waiting on it,
+// spawn_future() does the same but hands back a sender for the result,
+// and join() gives a sender that completes once everything spawned so
+// far has finished. Unlike stdexec::start_detached, the spawned
+// operation states come out of qpools, which keep per-shepherd free
+// lists, and the number of tasks in flight can be capped: spawn then
+// suspends the calling qthread on a FEB until a slot frees up.
+// Spawned work sees a stop token that fires on request_stop().
+// The scope has to be joined before it's destroyed, and any futures
+// have to be consumed or dropped before that too.
+class counting_scope {
+public:
+  static constexpr std::size_t unbounded =
+    std::numeric_limits<std::size_t>::max();
+
+  explicit counting_scope(std::size_t max_in_flight = unbounded) noexcept:
+    max_in_flight_(max_in_flight ? max_in_flight : 1) {
+    qt_sinc_init(&idle_, 0, NULL, NULL, 0);
+  }
+
+  counting_scope(counting_scope const &) = delete;
+  counting_scope &operator=(counting_scope const &) = delete;
+
+  // Same as stdexec's scopes, destroying one with work still in flight
+  // is a bug, not something to recover from.
+  ~counting_scope() {
+    if (in_flight_.load() != 0) std::terminate();
+    qt_sinc_fini(&idle_);
+    // Left empty if the last waiter took the last free slot.
+    qthread_fill(&slot_free_);
+    for (auto &p : pools_) {
+      if (qpool *pool = p.load()) qpool_destroy(pool);
+    }
+  }
+
+  template <stdexec::sender Sender>
+  void spawn(Sender &&sndr);
+
+  template <stdexec::sender Sender>
+  qthreads_scope_future_sender<std::remove_cvref_t<Sender>>
+  spawn_future(Sender &&sndr);
+
+  qthreads_scope_join_sender join() noexcept;
+
+  void request_stop() noexcept { stop_source_.request_stop(); }
+
+  std::size_t in_flight() const noexcept { return in_flight_.load(); }
+
+  qthreads_when_all_env get_env() const noexcept {
+    return {stop_source_.get_token()};
+  }
+private:
+  template <typename Sender>
+  friend struct scope_spawn_op;
+  template <typename Sender>
+  friend struct scope_future_state;
+  friend struct qthreads_scope_join_sender;
+  template <typename Receiver>
+  friend struct scope_join_operation_state;
+
+  // Op states are sorted into pools by size in steps of a cache line.
+  // Anything bigger than the largest class, or more aligned than a
+  // cache line, goes to the global allocator instead.
+  static constexpr std::size_t size_step = 64;
+  static constexpr std::size_t num_size_classes = 16;
+
+  // Every slot in use also counts towards idle_, which join waits on.
+  // At the cap, the caller suspends on slot_free_, which gets filled
+  // whenever the count drops from the cap. A waiter that gets a slot and
+  // sees there's still room passes the wakeup on to the next one.
+  void acquire_slot() noexcept {
+    std::size_t n = in_flight_.load(std::memory_order_relaxed);
+    for (;;) {
+      if (n < max_in_flight_) {
+        if (in_flight_.compare_exchange_weak(n, n + 1)) break;
+      } else {
+        qthread_readFE(NULL, &slot_free_);
+        n = in_flight_.load(std::memory_order_relaxed);
+      }
+    }
+    if (n + 1 < max_in_flight_ && max_in_flight_ != unbounded) {
+      qthread_fill(&slot_free_);
+    }
+    qt_sinc_expect(&idle_, 1);
+  }
+
+  // The sinc goes last, a finished join may destroy the scope.
+  void release_slot() noexcept {
+    if (in_flight_.fetch_sub(1) == max_in_flight_) qthread_fill(&slot_free_);
+    qt_sinc_submit(&idle_, NULL);
+  }
+
+  qpool *pool_for(std::size_t size, std::size_t align) {
+    std::size_t cls = (size + size_step - 1) / size_step;
+    if (align > size_step || cls == 0 || cls > num_size_classes) {
+      return nullptr;
+    }
+    auto &slot = pools_[cls - 1];
+    qpool *pool = slot.load(std::memory_order_acquire);
+    if (pool) return pool;
+    qpool *fresh = qpool_create_aligned(cls * size_step, size_step);
+    if (!fresh) throw std::bad_alloc();
+    if (slot.compare_exchange_strong(pool, fresh)) return fresh;
+    // Somebody else created it first.
+    qpool_destroy(fresh);
+    return pool;
+  }
+
+  void *allocate(std::size_t size, std::size_t align) {
+    if (qpool *pool = pool_for(size, align)) {
+      if (void *p = qpool_alloc(pool)) return p;
+      throw std::bad_alloc();
+    }
+    return ::operator new(size, std::align_val_t(align));
+  }
+
+  void deallocate(void *p, std::size_t size, std::size_t align) noexcept {
+    if (qpool *pool = pool_for(size, align)) {
+      qpool_free(pool, p);
+    } else {
+      ::operator delete(p, std::align_val_t(align));
+    }
+  }
+
+  std::size_t max_in_flight_;
+  std::atomic<std::size_t> in_flight_{0};
+  qt_sinc_t idle_;
+  aligned_t slot_free_{0};
+  stdexec::inplace_stop_source stop_source_{};
+  std::atomic<qpool *> pools_[num_size_classes]{};
+};
+
+// Receiver for spawned work. The result is dropped, and like
+// start_detached an error is fatal since nobody is there to see it.
+template <typename Sender>
+struct scope_spawn_receiver {
+  using receiver_concept = stdexec::receiver_t;
+  scope_spawn_op<Sender> *op;
+
+  template <class... As>
+  void set_value(As &&...) noexcept {
+    op->done();
+  }
+
+  template <class E>
+  void set_error(E &&) noexcept {
+    std::terminate();
+  }
+
+  void set_stopped() noexcept { op->done(); }
+
+  qthreads_when_all_env get_env() const noexcept {
+    return op->scope->get_env();
+  }
+};
+
+template <typename Sender>
+struct scope_spawn_op {
+  counting_scope *scope;
+  stdexec::connect_result_t<Sender, scope_spawn_receiver<Sender>> op;
+
+  template <typename Sender_>
+  scope_spawn_op(counting_scope *scope_, Sender_ &&sndr):
+    scope(scope_), op(qt_emplace_from{[&] {
+      return stdexec::connect(static_cast<Sender_ &&>(sndr),
+                              scope_spawn_receiver<Sender>{this});
+    }}) {}
+
+  // Called from the completion of op, so nothing in here may be touched
+  // after it's destroyed.
+  void done() noexcept {
+    counting_scope *s = scope;
+    this->~scope_spawn_op();
+    s->deallocate(this, sizeof(scope_spawn_op), alignof(scope_spawn_op));
+    s->release_slot();
+  }
+};
+
+template <stdexec::sender Sender>
+void counting_scope::spawn(Sender &&sndr) {
+  using op_t = scope_spawn_op<std::remove_cvref_t<Sender>>;
+  acquire_slot();
+  op_t *op;
+  void *mem = nullptr;
+  try {
+    mem = allocate(sizeof(op_t), alignof(op_t));
+    op = ::new (mem) op_t(this, static_cast<Sender &&>(sndr));
+  } catch (...) {
+    if (mem) deallocate(mem, sizeof(op_t), alignof(op_t));
+    release_slot();
+    throw;
+  }
+  stdexec::start(op->op);
+}
+
+// Receiver for work started by spawn_future. Stores the result in the
+// shared state and fills its FEB to wake up the future.
+template <typename Sender>
+struct scope_future_receiver {
+  using receiver_concept = stdexec::receiver_t;
+  scope_future_state<Sender> *state;
+
+  template <class... As>
+  void set_value(As &&...as) noexcept {
+    state->result.set_value(static_cast<As &&>(as)...);
+    state->done();
+  }
+
+  template <class E>
+  void set_error(E &&e) noexcept {
+    state->result.set_error(static_cast<E &&>(e));
+    state->done();
+  }
+
+  void set_stopped() noexcept {
+    state->result.set_stopped();
+    state->done();
+  }
+
+  qthreads_when_all_env get_env() const noexcept {
+    return state->scope->get_env();
+  }
+};
+
+// State shared by the work started by spawn_future and the future.
+// It's freed by whichever of the two lets go of it last.
+template <typename Sender>
+struct scope_future_state {
+  using value_t = qt_value_tuple_t<Sender, qthreads_when_all_env>;
+
+  counting_scope *scope;
+  aligned_t feb;
+  std::atomic<int> refs{2};
+  qt_async_result<value_t> result{};
+  stdexec::connect_result_t<Sender, scope_future_receiver<Sender>> op;
+
+  template <typename Sender_>
+  scope_future_state(counting_scope *scope_, Sender_ &&sndr):
+    scope(scope_), op(qt_emplace_from{[&] {
+      return stdexec::connect(static_cast<Sender_ &&>(sndr),
+                              scope_future_receiver<Sender>{this});
+    }}) {
+    qthread_empty(&feb);
+  }
+
+  // Called from the completion of op.
+  void done() noexcept {
+    counting_scope *s = scope;
+    qthread_fill(&feb);
+    release();
+    s->release_slot();
+  }
+
+  void release() noexcept {
+    if (refs.fetch_sub(1) == 1) {
+      counting_scope *s = scope;
+      this->~scope_future_state();
+      s->deallocate(
+        this, sizeof(scope_future_state), alignof(scope_future_state));
+    }
+  }
+};
+
+// Operation state for a future. Its qthread suspends on the FEB of the
+// shared state until the spawned work is done, then completes with
+// whatever the work completed with.
+template <typename Sender, typename Receiver>
+struct scope_future_operation_state :
+  qt_os_base<scope_future_operation_state<Sender, Receiver>, Receiver> {
+  scope_future_state<Sender> *state;
+
+  template <typename Receiver_>
+  scope_future_operation_state(scope_future_state<Sender> *state_,
+                               Receiver_ &&receiver):
+    qt_os_base<scope_future_operation_state<Sender, Receiver>, Receiver>(
+      std::forward<Receiver_>(receiver)),
+    state(state_) {}
+
+  ~scope_future_operation_state() {
+    if (state) state->release();
+  }
+
+  static aligned_t task(void *os_void) noexcept {
+    auto *os = static_cast<scope_future_operation_state *>(os_void);
+    qthread_readFF(NULL, &os->state->feb);
+    auto result = std::move(os->state->result);
+    os->state->release();
+    os->state = nullptr;
+    std::move(result).complete(os);
+    return 0u;
+  }
+};
+
+// Sender for the result of work started by spawn_future.
+// It owns a reference to the shared state, so dropping it without
+// connecting lets the work clean up after itself.
+template <typename Sender>
+struct qthreads_scope_future_sender :
+  qthreads_base_sender<qthreads_scope_future_sender<Sender>> {
+  scope_future_state<Sender> *state;
+
+  using completion_signatures = stdexec::completion_signatures<
+    typename qt_set_value_sig<
+      typename scope_future_state<Sender>::value_t>::type,
+    stdexec::set_error_t(int),
+    stdexec::set_error_t(std::exception_ptr),
+    stdexec::set_stopped_t()>;
+
+  explicit qthreads_scope_future_sender(
+    scope_future_state<Sender> *state_) noexcept:
+    state(state_) {}
+
+  qthreads_scope_future_sender(qthreads_scope_future_sender &&other) noexcept:
+    state(std::exchange(other.state, nullptr)) {}
+
+  qthreads_scope_future_sender(qthreads_scope_future_sender const &) = delete;
+
+  ~qthreads_scope_future_sender() {
+    if (state) state->release();
+  }
+
+  template <typename Receiver>
+  scope_future_operation_state<Sender, std::remove_cvref_t<Receiver>>
+  connect(Receiver &&receiver) && {
+    return {std::exchange(state, nullptr), std::forward<Receiver>(receiver)};
+  }
+};
+
+template <stdexec::sender Sender>
+qthreads_scope_future_sender<std::remove_cvref_t<Sender>>
+counting_scope::spawn_future(Sender &&sndr) {
+  using state_t = scope_future_state<std::remove_cvref_t<Sender>>;
+  acquire_slot();
+  state_t *state;
+  void *mem = nullptr;
+  try {
+    mem = allocate(sizeof(state_t), alignof(state_t));
+    state = ::new (mem) state_t(this, static_cast<Sender &&>(sndr));
+  } catch (...) {
+    if (mem) deallocate(mem, sizeof(state_t), alignof(state_t));
+    release_slot();
+    throw;
+  }
+  stdexec::start(state->op);
+  return qthreads_scope_future_sender<std::remove_cvref_t<Sender>>{state};
+}
+
+// Operation state for join. Its qthread suspends on the scope's sinc
+// until nothing spawned on it is in flight anymore, so waiting doesn't
+// hold a worker.
+template <typename Receiver>
+struct scope_join_operation_state :
+  qt_os_base<scope_join_operation_state<Receiver>, Receiver> {
+  counting_scope *scope;
+
+  template <typename Receiver_>
+  scope_join_operation_state(counting_scope *scope_, Receiver_ &&receiver):
+    qt_os_base<scope_join_operation_state<Receiver>, Receiver>(
+      std::forward<Receiver_>(receiver)),
+    scope(scope_) {}
+
+  static aligned_t task(void *os_void) noexcept {
+    auto *os = static_cast<scope_join_operation_state *>(os_void);
+    qt_sinc_wait(&os->scope->idle_, NULL);
+    os->complete_value();
+    return 0u;
+  }
+};
+
+struct qthreads_scope_join_sender :
+  qthreads_base_sender<qthreads_scope_join_sender> {
+  counting_scope *scope;
+
+  using completion_signatures =
+    stdexec::completion_signatures<stdexec::set_value_t(),
+                                   stdexec::set_stopped_t(),
+                                   stdexec::set_error_t(int)>;
+
+  template <typename Receiver>
+  scope_join_operation_state<std::remove_cvref_t<Receiver>>
+  connect(Receiver &&receiver) && {
+    return {scope, std::forward<Receiver>(receiver)};
+  }
+};
+
+inline qthreads_scope_join_sender counting_scope::join() noexcept {
+  return {{}, this};
+}
+
+} // namespace stdexx
@@ -0,0 +1,224 @@
+#pragma once
+
+#include <qthreads/stdexec.hpp>
+
+namespace stdexx {
+
+// Senders for qthreads full/empty bit synchronization.
+// Every aligned_t word has a FEB. Reads wait for the word to be full,
+// and since they run inside a qthread, a waiting read only suspends
+// that ULT while the worker moves on to other tasks.
+// These give single-assignment dataflow: a producer fills a word once
+// and any number of consumers chained on feb_read run once it's full.
+// Note: a read that is already waiting on its FEB can't be interrupted,
+// stop requests are only seen before the qthread starts.
+
+// Operation state for feb_read. Completes with the word once it's full,
+// leaving it full for the other readers.
+template <typename Receiver>
+struct feb_read_operation_state :
+  qt_os_base<feb_read_operation_state<Receiver>, Receiver> {
+  aligned_t *addr;
+
+  template <typename Receiver_>
+  feb_read_operation_state(aligned_t *addr_, Receiver_ &&receiver):
+    qt_os_base<feb_read_operation_state<Receiver>, Receiver>(
+      std::forward<Receiver_>(receiver)),
+    addr(addr_) {}
+
+  static aligned_t task(void *os_void) noexcept {
+    auto *os = static_cast<feb_read_operation_state *>(os_void);
+    aligned_t val;
+    qthread_readFF(&val, os->addr);
+    os->complete_value(val);
+    return 0u;
+  }
+};
+
+// Operation state for feb_write. Stores the value and marks the word
+// full, waking up the readers waiting on it.
+template <typename Receiver>
+struct feb_write_operation_state :
+  qt_os_base<feb_write_operation_state<Receiver>, Receiver> {
+  aligned_t *addr;
+  aligned_t val;
+
+  template <typename Receiver_>
+  feb_write_operation_state(aligned_t *addr_,
+                            aligned_t val_,
+                            Receiver_ &&receiver):
+    qt_os_base<feb_write_operation_state<Receiver>, Receiver>(
+      std::forward<Receiver_>(receiver)),
+    addr(addr_), val(val_) {}
+
+  static aligned_t task(void *os_void) noexcept {
+    auto *os = static_cast<feb_write_operation_state *>(os_void);
+    qthread_writeF_const(os->addr, os->val);
+    os->complete_value();
+    return 0u;
+  }
+};
+
+struct feb_read_sender : qthreads_base_sender<feb_read_sender> {
+  aligned_t *addr;
+
+  using completion_signatures =
+    stdexec::completion_signatures<stdexec::set_value_t(aligned_t),
+                                   stdexec::set_stopped_t(),
+                                   stdexec::set_error_t(int)>;
+
+  template <typename Receiver>
+  feb_read_operation_state<std::remove_cvref_t<Receiver>>
+  connect(Receiver &&receiver) && {
+    return {addr, std::forward<Receiver>(receiver)};
+  }
+};
+
+struct feb_write_sender : qthreads_base_sender<feb_write_sender> {
+  aligned_t *addr;
+  aligned_t val;
+
+  using completion_signatures =
+    stdexec::completion_signatures<stdexec::set_value_t(),
+                                   stdexec::set_stopped_t(),
+                                   stdexec::set_error_t(int)>;
+
+  template <typename Receiver>
+  feb_write_operation_state<std::remove_cvref_t<Receiver>>
+  connect(Receiver &&receiver) && {
+    return {addr, val, std::forward<Receiver>(receiver)};
+  }
+};
+
+// Sender that completes with the value of *addr once its FEB is full.
+inline feb_read_sender feb_read(aligned_t *addr) noexcept {
+  return {{}, addr};
+}
+
+// Sender that writes val to *addr and marks it full.
+inline feb_write_sender feb_write(aligned_t *addr, aligned_t val) noexcept {
+  return {{}, addr, val};
+}
+
+template <typename T>
+struct feb_var;
+
+// Operation states for feb_var. Same as the ones above, except that the
+// FEB word is only used as the flag and the payload lives next to it.
+template <typename T, typename Receiver>
+struct feb_var_read_operation_state :
+  qt_os_base<feb_var_read_operation_state<T, Receiver>, Receiver> {
+  feb_var<T> *var;
+
+  template <typename Receiver_>
+  feb_var_read_operation_state(feb_var<T> *var_, Receiver_ &&receiver):
+    qt_os_base<feb_var_read_operation_state<T, Receiver>, Receiver>(
+      std::forward<Receiver_>(receiver)),
+    var(var_) {}
+
+  static aligned_t task(void *os_void) noexcept {
+    auto *os = static_cast<feb_var_read_operation_state *>(os_void);
+    qthread_readFF(NULL, &os->var->feb);
+    try {
+      os->complete_value(T(os->var->value));
+    } catch (...) {
+      os->complete_error(std::current_exception());
+    }
+    return 0u;
+  }
+};
+
+template <typename T, typename Receiver>
+struct feb_var_write_operation_state :
+  qt_os_base<feb_var_write_operation_state<T, Receiver>, Receiver> {
+  feb_var<T> *var;
+  T val;
+
+  template <typename T_, typename Receiver_>
+  feb_var_write_operation_state(feb_var<T> *var_,
+                                T_ &&val_,
+                                Receiver_ &&receiver):
+    qt_os_base<feb_var_write_operation_state<T, Receiver>, Receiver>(
+      std::forward<Receiver_>(receiver)),
+    var(var_), val(std::forward<T_>(val_)) {}
+
+  static aligned_t task(void *os_void) noexcept {
+    auto *os = static_cast<feb_var_write_operation_state *>(os_void);
+    try {
+      os->var->value = std::move(os->val);
+    } catch (...) {
+      os->complete_error(std::current_exception());
+      return 0u;
+    }
+    qthread_fill(&os->var->feb);
+    os->complete_value();
+    return 0u;
+  }
+};
+
+template <typename T>
+struct feb_var_read_sender : qthreads_base_sender<feb_var_read_sender<T>> {
+  feb_var<T> *var;
+
+  using completion_signatures =
+    stdexec::completion_signatures<stdexec::set_value_t(T),
+                                   stdexec::set_stopped_t(),
+                                   stdexec::set_error_t(int),
+                                   stdexec::set_error_t(std::exception_ptr)>;
+
+  template <typename Receiver>
+  feb_var_read_operation_state<T, std::remove_cvref_t<Receiver>>
+  connect(Receiver &&receiver) && {
+    return {var, std::forward<Receiver>(receiver)};
+  }
+};
+
+template <typename T>
+struct feb_var_write_sender : qthreads_base_sender<feb_var_write_sender<T>> {
+  feb_var<T> *var;
+  T val;
+
+  using completion_signatures =
+    stdexec::completion_signatures<stdexec::set_value_t(),
+                                   stdexec::set_stopped_t(),
+                                   stdexec::set_error_t(int),
+                                   stdexec::set_error_t(std::exception_ptr)>;
+
+  template <typename Receiver>
+  feb_var_write_operation_state<T, std::remove_cvref_t<Receiver>>
+  connect(Receiver &&receiver) && {
+    return {var, std::move(val), std::forward<Receiver>(receiver)};
+  }
+};
+
+// A single-assignment variable of any type guarded by a FEB.
+// write() stores the value and fills the FEB, read() waits for it
+// to be full and sends a copy of the value.
+// It starts out empty, so the runtime has to be initialized before one
+// is constructed. It's shared by pointer between the senders, so it
+// can't be moved and has to outlive them.
+template <typename T>
+struct feb_var {
+  T value{};
+  aligned_t feb;
+
+  feb_var() { qthread_empty(&feb); }
+
+  // Never written to, the FEB would still be empty and qthreads would
+  // keep its entry around.
+  ~feb_var() { qthread_fill(&feb); }
+
+  feb_var(feb_var const &) = delete;
+  feb_var &operator=(feb_var const &) = delete;
+
+  feb_var_read_sender<T> read() noexcept { return {{}, this}; }
+
+  template <typename U>
+  feb_var_write_sender<T> write(U &&val) {
+    return {{}, this, T(std::forward<U>(val))};
+  }
+
+  bool full() const noexcept { return qthread_feb_status(&feb); }
+};
+
+} // namespace stdexx
@@ -0,0 +1,352 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include <qthreads/reduce.hpp>
+#include <qthreads/stdexec.hpp>
+
+namespace stdexx {
+
+// Loop fusion for memory-bound bulk stages.
+// Back to back stdexec::bulk calls each stream their vectors through
+// memory once. When the stages are element-wise, i.e. index i of one
+// stage only depends on index i of the ones before it, they can just as
+// well run in a single traversal:
+//
+//   sndr | stdexx::fused_bulk(n, update_x, update_r)
+//
+// runs update_x(i) then update_r(i) for every i, over the same chunked
+// ranges as our bulk. A trailing reduction can be folded in too, which
+// then sends the sum instead of the values of sndr:
+//
+//   sndr | stdexx::fused_bulk(n, update_x, update_r)
+//            .then_reduce(0.0, [=](auto i, double &acc) {
+//              acc += r[i] * r[i];
+//            })
+//
+// This can't tell whether the stages really are element-wise. A stage
+// that reads other indices (e.g. spmv reading x) can only come first,
+// and only if no other stage writes what it reads.
+// Like bulk, the stages get the values sent by sndr as lvalues after i.
+
+// Per-invocation state for fused_bulk, same as qthreads_bulk_loop except
+// that every index runs all of the stages.
+template <typename Shape, typename Fs, typename... As>
+struct qthreads_fused_loop {
+  Fs &fs;
+  std::tuple<As &...> args;
+  std::atomic<bool> const *stop_flag;
+  std::atomic<bool> failed{false};
+  std::exception_ptr error{};
+
+  static void chunk(size_t begin, size_t end, void *arg) {
+    auto *loop = static_cast<qthreads_fused_loop *>(arg);
+    *qt_stop_flag_slot() = loop->stop_flag;
+    try {
+      std::apply(
+        [&](As &...as) {
+          std::apply(
+            [&](auto &...f) {
+              for (size_t i = begin; i < end; ++i) {
+                (f(static_cast<Shape>(i), as...), ...);
+              }
+            },
+            loop->fs);
+        },
+        loop->args);
+    } catch (...) {
+      if (!loop->failed.exchange(true)) {
+        loop->error = std::current_exception();
+      }
+    }
+  }
+};
+
+// Same with a trailing reduction. Like reduce, this loops over a fixed
+// set of chunks so the sum comes out the same on every run. Every chunk
+// starts from T{} and sums into its own padded partial.
+template <typename Shape, typename T, typename G, typename Fs, typename... As>
+struct qthreads_fused_reduce_loop {
+  Fs &fs;
+  G &g;
+  qt_padded<T> *partials;
+  std::size_t n;
+  std::size_t num_chunks;
+  std::tuple<As &...> args;
+  std::atomic<bool> const *stop_flag;
+  std::atomic<bool> failed{false};
+  std::exception_ptr error{};
+
+  static void chunk(size_t begin, size_t end, void *arg) {
+    auto *loop = static_cast<qthreads_fused_reduce_loop *>(arg);
+    *qt_stop_flag_slot() = loop->stop_flag;
+    try {
+      std::apply(
+        [&](As &...as) {
+          std::apply(
+            [&](auto &...f) {
+              for (size_t c = begin; c < end; ++c) {
+                size_t first = qt_chunk_begin(loop->n, loop->num_chunks, c);
+                size_t last = qt_chunk_begin(loop->n, loop->num_chunks, c + 1);
+                T acc{};
+                for (size_t i = first; i < last; ++i) {
+                  (f(static_cast<Shape>(i), as...), ...);
+                  loop->g(static_cast<Shape>(i), acc, as...);
+                }
+                loop->partials[c].value = std::move(acc);
+              }
+            },
+            loop->fs);
+        },
+        loop->args);
+    } catch (...) {
+      if (!loop->failed.exchange(true)) {
+        loop->error = std::current_exception();
+      }
+    }
+  }
+};
+
+// Receiver for fused_bulk. Like the bulk receiver, everything happens
+// inside set_value in the qthread that completed the predecessor.
+template <class R, class Shape, class Fs>
+class qthreads_fused_bulk_receiver :
+  public stdexec::receiver_adaptor<qthreads_fused_bulk_receiver<R, Shape, Fs>,
+                                   R> {
+public:
+  qthreads_fused_bulk_receiver(R r, Shape shape_, Fs fs_):
+    stdexec::receiver_adaptor<qthreads_fused_bulk_receiver, R>{std::move(r)},
+    shape(shape_), fs(std::move(fs_)) {}
+
+  template <class... As>
+  void set_value(As &&...as) && noexcept {
+    qthreads_fused_loop<Shape, Fs, std::remove_reference_t<As>...> loop{
+      fs, {as...}, nullptr};
+    {
+      qt_scoped_stop_flag<R> stop(this->base());
+      loop.stop_flag = stop.get();
+      if (shape > Shape(0)) {
+        qt_loop_balance(0,
+                        static_cast<size_t>(shape),
+                        &decltype(loop)::chunk,
+                        static_cast<void *>(&loop));
+      }
+    }
+    if (loop.failed.load()) {
+      stdexec::set_error(std::move(*this).base(), std::move(loop.error));
+    } else {
+      stdexec::set_value(std::move(*this).base(), static_cast<As &&>(as)...);
+    }
+  }
+private:
+  Shape shape;
+  Fs fs;
+};
+
+// Receiver for fused_bulk(...).then_reduce(...). The partials are kept
+// here so that they're only allocated once per operation. Same as for
+// reduce, init is added once to the combined partials, which start from
+// T{} and so need that to be the identity of +, e.g. 0 for numbers.
+template <class R, class Shape, class T, class G, class Fs>
+class qthreads_fused_reduce_receiver :
+  public stdexec::receiver_adaptor<
+    qthreads_fused_reduce_receiver<R, Shape, T, G, Fs>,
+    R> {
+public:
+  qthreads_fused_reduce_receiver(R r, Shape shape_, T init_, G g_, Fs fs_):
+    stdexec::receiver_adaptor<qthreads_fused_reduce_receiver, R>{
+      std::move(r)},
+    shape(shape_), init(std::move(init_)), g(std::move(g_)),
+    fs(std::move(fs_)) {}
+
+  template <class... As>
+  void set_value(As &&...as) && noexcept {
+    try {
+      std::size_t n = shape > Shape(0) ? static_cast<std::size_t>(shape) : 0;
+      std::size_t num_chunks = qt_reduce_chunks(n);
+      if (num_chunks == 0) {
+        stdexec::set_value(std::move(*this).base(), T(init));
+        return;
+      }
+      if (partials.size() < num_chunks) partials.resize(num_chunks);
+      qthreads_fused_reduce_loop<Shape,
+                                 T,
+                                 G,
+                                 Fs,
+                                 std::remove_reference_t<As>...>
+        loop{fs,
+             g,
+             partials.data(),
+             n,
+             num_chunks,
+             {as...},
+             nullptr};
+      {
+        qt_scoped_stop_flag<R> stop(this->base());
+        loop.stop_flag = stop.get();
+        qt_loop_balance(0,
+                        num_chunks,
+                        &decltype(loop)::chunk,
+                        static_cast<void *>(&loop));
+      }
+      if (loop.failed.load()) {
+        stdexec::set_error(std::move(*this).base(), std::move(loop.error));
+        return;
+      }
+      std::plus<> plus;
+      qt_tree_combine(partials.data(), num_chunks, plus);
+      stdexec::set_value(std::move(*this).base(),
+                         plus(T(init), std::move(partials[0].value)));
+    } catch (...) {
+      stdexec::set_error(std::move(*this).base(), std::current_exception());
+    }
+  }
+private:
+  Shape shape;
+  T init;
+  G g;
+  Fs fs;
+  std::vector<qt_padded<T>> partials{};
+};
+
+template <stdexec::sender S, typename Shape, typename Fs>
+struct qthreads_fused_bulk_sender :
+  qthreads_base_sender<qthreads_fused_bulk_sender<S, Shape, Fs>> {
+  S s;
+  Shape shape;
+  Fs fs;
+
+  template <class Env>
+  using completions_t = stdexec::transform_completion_signatures_of<
+    S,
+    Env,
+    stdexec::completion_signatures<stdexec::set_error_t(std::exception_ptr)>>;
+
+  template <class Env>
+  auto get_completion_signatures(Env &&) && -> completions_t<Env> {
+    return {};
+  }
+
+  template <stdexec::receiver R>
+    requires stdexec::sender_to<S, qthreads_fused_bulk_receiver<R, Shape, Fs>>
+  auto connect(R r) && {
+    return stdexec::connect(
+      std::move(s),
+      qthreads_fused_bulk_receiver<R, Shape, Fs>{
+        static_cast<R &&>(r), shape, static_cast<Fs &&>(fs)});
+  }
+};
+
+template <stdexec::sender S,
+          typename Shape,
+          typename T,
+          typename G,
+          typename Fs>
+struct qthreads_fused_reduce_sender :
+  qthreads_base_sender<qthreads_fused_reduce_sender<S, Shape, T, G, Fs>> {
+  S s;
+  Shape shape;
+  T init;
+  G g;
+  Fs fs;
+
+  template <class Env>
+  using completions_t = stdexec::transform_completion_signatures_of<
+    S,
+    Env,
+    stdexec::completion_signatures<stdexec::set_error_t(std::exception_ptr)>,
+    qt_reduce_value<T>::template type>;
+
+  template <class Env>
+  auto get_completion_signatures(Env &&) && -> completions_t<Env> {
+    return {};
+  }
+
+  template <stdexec::receiver R>
+    requires stdexec::sender_to<
+      S,
+      qthreads_fused_reduce_receiver<R, Shape, T, G, Fs>>
+  auto connect(R r) && {
+    using receiver_t = qthreads_fused_reduce_receiver<R, Shape, T, G, Fs>;
+    return stdexec::connect(std::move(s),
+                            receiver_t{static_cast<R &&>(r),
+                                       shape,
+                                       std::move(init),
+                                       static_cast<G &&>(g),
+                                       static_cast<Fs &&>(fs)});
+  }
+};
+
+// Pipeable closure returned by fused_bulk(...).then_reduce(...).
+template <typename Shape, typename T, typename G, typename Fs>
+struct fused_reduce_closure :
+  stdexec::sender_adaptor_closure<fused_reduce_closure<Shape, T, G, Fs>> {
+  Shape shape;
+  T init;
+  G g;
+  Fs fs;
+
+  template <stdexec::sender S>
+  auto operator()(S &&s) const & {
+    return qthreads_fused_reduce_sender<std::remove_cvref_t<S>,
+                                        Shape,
+                                        T,
+                                        G,
+                                        Fs>{
+      {}, static_cast<S &&>(s), shape, init, g, fs};
+  }
+
+  template <stdexec::sender S>
+  auto operator()(S &&s) && {
+    return qthreads_fused_reduce_sender<std::remove_cvref_t<S>,
+                                        Shape,
+                                        T,
+                                        G,
+                                        Fs>{
+      {}, static_cast<S &&>(s), shape, std::move(init), std::move(g),
+      std::move(fs)};
+  }
+};
+
+// Pipeable closure returned by fused_bulk.
+template <typename Shape, typename Fs>
+struct fused_bulk_closure :
+  stdexec::sender_adaptor_closure<fused_bulk_closure<Shape, Fs>> {
+  Shape shape;
+  Fs fs;
+
+  template <stdexec::sender S>
+  auto operator()(S &&s) const & {
+    return qthreads_fused_bulk_sender<std::remove_cvref_t<S>, Shape, Fs>{
+      {}, static_cast<S &&>(s), shape, fs};
+  }
+
+  template <stdexec::sender S>
+  auto operator()(S &&s) && {
+    return qthreads_fused_bulk_sender<std::remove_cvref_t<S>, Shape, Fs>{
+      {}, static_cast<S &&>(s), shape, std::move(fs)};
+  }
+
+  // Folds a sum over g(i, acc, values...) into the same traversal.
+  template <typename T, typename G>
+  auto then_reduce(T init, G &&g) && {
+    return fused_reduce_closure<Shape, T, std::decay_t<G>, Fs>{
+      {}, shape, std::move(init), std::forward<G>(g), std::move(fs)};
+  }
+};
+
+// Runs all of the given element-wise stages in one traversal of
+// [0, shape), see above.
+template <typename Shape, typename... Fs>
+auto fused_bulk(Shape shape, Fs &&...fs) {
+  return fused_bulk_closure<Shape, std::tuple<std::decay_t<Fs>...>>{
+    {}, shape, {std::forward<Fs>(fs)...}};
+}
+
+} // namespace stdexx
@@ -0,0 +1,405 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include <qthreads/reduce.hpp>
+#include <qthreads/stdexec.hpp>
+
+namespace stdexx {
+
+// Task graph capture and replay, along the lines of Kokkos Graph.
+// create_graph records a DAG of kernels once: every node is allocated,
+// linked to its successors and sized for its scratch space up front.
+// submit() then returns a sender that runs the whole DAG, and can be
+// called again every time the DAG has to be run, e.g. once per solver
+// iteration, without connecting, allocating or building anything anew.
+// Nodes see their inputs through whatever they captured, so anything
+// that changes between replays (scalars of a solver, say) has to be
+// captured by reference or pointer.
+//
+//   auto g = stdexx::create_graph([&](stdexx::graph_node root) {
+//     auto a = root.then_bulk(n, axpby);
+//     auto b = root.then_reduce(n, 0.0, dot, store);
+//     stdexx::when_all(a, b).then(update);
+//   });
+//   for (int k = 0; k < iters; ++k) stdexec::sync_wait(g.submit());
+//
+// Nodes are kernels, not senders: a task, a bulk loop or a reduction
+// over plain callables. Replaying a sender would mean connecting it
+// again, so a graph can't capture an arbitrary sender chain (let_value,
+// timers, nested when_any and the like). Sender work goes around the
+// graph instead, e.g. g.submit() | stdexec::then(...).
+// A node that throws fails the submission with its exception, and a
+// stop request completes it with set_stopped. Either way the nodes that
+// haven't run yet are skipped, and the graph can be submitted again.
+// Only one submission of a graph can be running at a time, a second one
+// fails with std::logic_error. The runtime has to be initialized before
+// a graph is created.
+
+struct qt_graph_state;
+
+// One captured node. Nodes are stored by the graph and never move.
+// pending counts the predecessors that haven't finished in the current
+// submission and is reset to num_deps before each one.
+struct qt_graph_node {
+  qt_graph_state *graph;
+  void (*body)(qt_graph_node *) noexcept;
+  std::size_t num_deps{0};
+  std::atomic<std::size_t> pending{0};
+  std::vector<qt_graph_node *> successors{};
+
+  qt_graph_node(qt_graph_state *graph_,
+                void (*body_)(qt_graph_node *) noexcept) noexcept:
+    graph(graph_), body(body_) {}
+
+  virtual ~qt_graph_node() = default;
+
+  // Entry point of the qthread running a node.
+  static aligned_t run(void *arg) noexcept;
+};
+
+// State of a graph. It's kept behind a pointer so that graph can be
+// moved around while the nodes keep pointing here.
+struct qt_graph_state {
+  std::vector<std::unique_ptr<qt_graph_node>> nodes{};
+  qt_graph_node *root{nullptr};
+  qt_sinc_t sinc;
+  // Cancellation flag of the task running the current submission.
+  std::atomic<bool> const *stop_flag{nullptr};
+  std::atomic<bool> failed{false};
+  std::exception_ptr error{};
+  std::atomic<bool> running{false};
+
+  qt_graph_state() { qt_sinc_init(&sinc, 0, NULL, NULL, 0); }
+
+  qt_graph_state(qt_graph_state const &) = delete;
+  qt_graph_state &operator=(qt_graph_state const &) = delete;
+
+  ~qt_graph_state() { qt_sinc_fini(&sinc); }
+
+  template <typename Node, typename... Args>
+  Node *add(Args &&...args) {
+    nodes.push_back(std::make_unique<Node>(this, std::forward<Args>(args)...));
+    return static_cast<Node *>(nodes.back().get());
+  }
+
+  static void link(qt_graph_node *from, qt_graph_node *to) {
+    from->successors.push_back(to);
+    ++to->num_deps;
+  }
+
+  // Nodes stop doing work once the submission failed or was cancelled,
+  // but still release their successors so the sinc gets drained.
+  bool skipping() const noexcept {
+    return failed.load(std::memory_order_relaxed) ||
+           (stop_flag && stop_flag->load(std::memory_order_relaxed));
+  }
+
+  // Only the first exception is kept, the rest are dropped.
+  void fail(std::exception_ptr e) noexcept {
+    if (!failed.exchange(true)) error = std::move(e);
+  }
+
+  void reset() noexcept {
+    failed.store(false, std::memory_order_relaxed);
+    error = nullptr;
+    for (auto &n : nodes) {
+      n->pending.store(n->num_deps, std::memory_order_relaxed);
+    }
+    qt_sinc_reset(&sinc, nodes.size());
+  }
+};
+
+// Runs the node, then every successor it was the last predecessor of.
+// The first ready successor continues in this same qthread instead of
+// being forked, so a linear chain runs without any forks at all.
+inline aligned_t qt_graph_node::run(void *arg) noexcept {
+  auto *node = static_cast<qt_graph_node *>(arg);
+  // Forked successors start without a stop flag of their own.
+  *qt_stop_flag_slot() = node->graph->stop_flag;
+  while (node) {
+    qt_graph_state *graph = node->graph;
+    if (!graph->skipping()) node->body(node);
+    qt_graph_node *next = nullptr;
+    for (auto *s : node->successors) {
+      if (s->pending.fetch_sub(1, std::memory_order_acq_rel) != 1) continue;
+      if (!next) {
+        next = s;
+      } else if (qthread_fork(&qt_graph_node::run, s, NULL) !=
+                 QTHREAD_SUCCESS) {
+        run(s);
+      }
+    }
+    qt_sinc_submit(&graph->sinc, NULL);
+    node = next;
+  }
+  return 0u;
+}
+
+// Node that runs f() once.
+template <typename F>
+struct qt_graph_task_node : qt_graph_node {
+  F f;
+
+  template <typename F_>
+  qt_graph_task_node(qt_graph_state *graph_, F_ &&f_):
+    qt_graph_node(graph_, &qt_graph_task_node::body), f(std::forward<F_>(f_)) {}
+
+  static void body(qt_graph_node *n) noexcept {
+    auto *node = static_cast<qt_graph_task_node *>(n);
+    try {
+      node->f();
+    } catch (...) {
+      node->graph->fail(std::current_exception());
+    }
+  }
+};
+
+// Node that runs f(i) for every i in [0, shape), spread over all the
+// workers with qt_loop_balance, same as our bulk.
+template <typename Shape, typename F>
+struct qt_graph_bulk_node : qt_graph_node {
+  Shape shape;
+  F f;
+
+  template <typename F_>
+  qt_graph_bulk_node(qt_graph_state *graph_, Shape shape_, F_ &&f_):
+    qt_graph_node(graph_, &qt_graph_bulk_node::body), shape(shape_),
+    f(std::forward<F_>(f_)) {}
+
+  static void chunk(size_t begin, size_t end, void *arg) {
+    auto *node = static_cast<qt_graph_bulk_node *>(arg);
+    *qt_stop_flag_slot() = node->graph->stop_flag;
+    try {
+      for (size_t i = begin; i < end; ++i) node->f(static_cast<Shape>(i));
+    } catch (...) {
+      node->graph->fail(std::current_exception());
+    }
+  }
+
+  static void body(qt_graph_node *n) noexcept {
+    auto *node = static_cast<qt_graph_bulk_node *>(n);
+    if (node->shape > Shape(0)) {
+      qt_loop_balance(0,
+                      static_cast<size_t>(node->shape),
+                      &qt_graph_bulk_node::chunk,
+                      static_cast<void *>(node));
+    }
+  }
+};
+
+// Node that sums f(i, acc) over [0, shape) and passes init plus that
+// sum to fin. Same fixed chunks and tree combine as stdexx::reduce, so
+// every replay gets the same sum, and same as fused_bulk's then_reduce
+// every chunk starts from T{}, init is only added once at the end. The
+// padded partials are sized when the node is captured.
+template <typename Shape, typename T, typename F, typename Final>
+struct qt_graph_reduce_node : qt_graph_node {
+  T init;
+  F f;
+  Final fin;
+  std::size_t n;
+  std::size_t num_chunks;
+  std::vector<qt_padded<T>> partials;
+
+  template <typename F_, typename Final_>
+  qt_graph_reduce_node(qt_graph_state *graph_,
+                       Shape shape_,
+                       T init_,
+                       F_ &&f_,
+                       Final_ &&fin_):
+    qt_graph_node(graph_, &qt_graph_reduce_node::body), init(init_),
+    f(std::forward<F_>(f_)), fin(std::forward<Final_>(fin_)),
+    n(shape_ > Shape(0) ? static_cast<std::size_t>(shape_) : 0),
+    num_chunks(qt_reduce_chunks(n)), partials(num_chunks) {}
+
+  static void chunk(size_t begin, size_t end, void *arg) {
+    auto *node = static_cast<qt_graph_reduce_node *>(arg);
+    *qt_stop_flag_slot() = node->graph->stop_flag;
+    try {
+      for (size_t c = begin; c < end; ++c) {
+        size_t first = qt_chunk_begin(node->n, node->num_chunks, c);
+        size_t last = qt_chunk_begin(node->n, node->num_chunks, c + 1);
+        T acc{};
+        for (size_t i = first; i < last; ++i) {
+          node->f(static_cast<Shape>(i), acc);
+        }
+        node->partials[c].value = std::move(acc);
+      }
+    } catch (...) {
+      node->graph->fail(std::current_exception());
+    }
+  }
+
+  static void body(qt_graph_node *n) noexcept {
+    auto *node = static_cast<qt_graph_reduce_node *>(n);
+    try {
+      T total = node->init;
+      if (node->num_chunks) {
+        qt_loop_balance(0,
+                        node->num_chunks,
+                        &qt_graph_reduce_node::chunk,
+                        static_cast<void *>(node));
+        std::plus<> plus;
+        qt_tree_combine(node->partials.data(), node->num_chunks, plus);
+        total = plus(std::move(total), std::move(node->partials[0].value));
+      }
+      if (!node->graph->skipping()) node->fin(std::move(total));
+    } catch (...) {
+      node->graph->fail(std::current_exception());
+    }
+  }
+};
+
+// Node that does nothing, for the root and for joins.
+struct qt_graph_empty_node : qt_graph_node {
+  explicit qt_graph_empty_node(qt_graph_state *graph_) noexcept:
+    qt_graph_node(graph_, &qt_graph_empty_node::body) {}
+
+  static void body(qt_graph_node *) noexcept {}
+};
+
+// Handle to a node while a graph is being captured. Each then* call
+// adds a node that runs after this one and returns a handle to it.
+class graph_node {
+public:
+  template <typename F>
+  graph_node then(F &&f) const {
+    auto *n = state->add<qt_graph_task_node<std::decay_t<F>>>(
+      std::forward<F>(f));
+    qt_graph_state::link(node, n);
+    return {state, n};
+  }
+
+  template <typename Shape, typename F>
+  graph_node then_bulk(Shape shape, F &&f) const {
+    auto *n = state->add<qt_graph_bulk_node<Shape, std::decay_t<F>>>(
+      shape, std::forward<F>(f));
+    qt_graph_state::link(node, n);
+    return {state, n};
+  }
+
+  template <typename Shape, typename T, typename F, typename Final>
+  graph_node then_reduce(Shape shape, T init, F &&f, Final &&fin) const {
+    auto *n = state->add<qt_graph_reduce_node<Shape,
+                                              T,
+                                              std::decay_t<F>,
+                                              std::decay_t<Final>>>(
+      shape, std::move(init), std::forward<F>(f), std::forward<Final>(fin));
+    qt_graph_state::link(node, n);
+    return {state, n};
+  }
+private:
+  friend class graph;
+  template <typename... Nodes>
+  friend graph_node when_all(graph_node const &, Nodes const &...);
+
+  graph_node(qt_graph_state *state_, qt_graph_node *node_) noexcept:
+    state(state_), node(node_) {}
+
+  qt_graph_state *state;
+  qt_graph_node *node;
+};
+
+// Node that runs once all of the given nodes have finished.
+template <typename... Nodes>
+graph_node when_all(graph_node const &first, Nodes const &...rest) {
+  static_assert((std::is_same_v<Nodes, graph_node> && ...),
+                "when_all on graph nodes only takes graph nodes.");
+  auto *n = first.state->add<qt_graph_empty_node>();
+  qt_graph_state::link(first.node, n);
+  (qt_graph_state::link(rest.node, n), ...);
+  return {first.state, n};
+}
+
+// Operation state for running one submission of a graph.
+// The root node runs in this qthread, which then suspends on the
+// graph's sinc until every node has finished.
+template <typename Receiver>
+struct graph_operation_state :
+  qt_os_base<graph_operation_state<Receiver>, Receiver> {
+  qt_graph_state *state;
+
+  template <typename Receiver_>
+  graph_operation_state(qt_graph_state *state_, Receiver_ &&receiver):
+    qt_os_base<graph_operation_state<Receiver>, Receiver>(
+      std::forward<Receiver_>(receiver)),
+    state(state_) {}
+
+  static aligned_t task(void *os_void) noexcept {
+    auto *os = static_cast<graph_operation_state *>(os_void);
+    qt_graph_state *state = os->state;
+    if (state->running.exchange(true)) {
+      os->complete_error(std::make_exception_ptr(
+        std::logic_error("stdexx::graph submitted while already running")));
+      return 0u;
+    }
+    state->stop_flag = &os->cancelled;
+    state->reset();
+    qt_graph_node::run(state->root);
+    qt_sinc_wait(&state->sinc, NULL);
+    state->stop_flag = nullptr;
+    bool failed = state->failed.load();
+    std::exception_ptr error = std::move(state->error);
+    state->running.store(false);
+    if (failed) {
+      os->complete_error(std::move(error));
+    } else if (os->cancelled.load(std::memory_order_relaxed)) {
+      os->complete_stopped();
+    } else {
+      os->complete_value();
+    }
+    return 0u;
+  }
+};
+
+struct qthreads_graph_sender : qthreads_base_sender<qthreads_graph_sender> {
+  qt_graph_state *state;
+
+  using completion_signatures =
+    stdexec::completion_signatures<stdexec::set_value_t(),
+                                   stdexec::set_stopped_t(),
+                                   stdexec::set_error_t(int),
+                                   stdexec::set_error_t(std::exception_ptr)>;
+
+  template <typename Receiver>
+  graph_operation_state<std::remove_cvref_t<Receiver>>
+  connect(Receiver &&receiver) && {
+    return {state, std::forward<Receiver>(receiver)};
+  }
+};
+
+// A captured task graph, see create_graph.
+class graph {
+public:
+  graph(): state(std::make_unique<qt_graph_state>()) {
+    state->root = state->add<qt_graph_empty_node>();
+  }
+
+  // Sender that runs every node of the graph once.
+  qthreads_graph_sender submit() const noexcept { return {{}, state.get()}; }
+
+  std::size_t size() const noexcept { return state->nodes.size(); }
+
+  graph_node root() const noexcept { return {state.get(), state->root}; }
+private:
+  std::unique_ptr<qt_graph_state> state;
+};
+
+// Captures a graph. build is called once with the root node and adds
+// the rest of the nodes through it.
+template <typename Build>
+graph create_graph(Build &&build) {
+  graph g;
+  std::forward<Build>(build)(g.root());
+  return g;
+}
+
+} // namespace stdexx
@@ -0,0 +1,215 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <ranges>
+#include <utility>
+#include <vector>
+
+#include <qthreads/stdexec.hpp>
+
+namespace stdexx {
+
+// Building blocks for parallel reductions on qthreads.
+// The iteration space is cut into a fixed number of chunks, one per
+// worker, and chunk c always covers the same [begin, end). Every chunk
+// sums into its own cache line, and the partials are then combined
+// pairwise in a fixed tree: ((p0 + p1) + (p2 + p3)) + ...
+// So for a given input and worker count, the result does not depend on
+// which worker happened to run which chunk, or in which order they
+// finished, and floating point sums come out the same on every run.
+// init never seeds a chunk, it's folded in once after the combine. That
+// goes for reduce, fused_bulk's then_reduce and graph reduce nodes
+// alike, so init doesn't have to be an identity and isn't counted once
+// per chunk.
+
+// Size of a cache line, for keeping per-worker data apart.
+// 64 bytes on everything we run on, hardware_destructive_interference_size
+// isn't used since GCC warns about it changing between targets.
+inline constexpr std::size_t qt_cache_line_size = 64;
+
+// A value on a cache line of its own, so that workers updating
+// neighbouring partials don't keep stealing the line from each other.
+template <typename T>
+struct alignas(qt_cache_line_size) qt_padded {
+  T value;
+};
+
+// Number of chunks a reduction over n elements is cut into. Never more
+// than n, so no chunk is empty.
+inline std::size_t qt_reduce_chunks(std::size_t n) noexcept {
+  return std::min(n, static_cast<std::size_t>(qthread_num_workers()));
+}
+
+// First index of chunk c out of num_chunks over [0, n).
+inline std::size_t qt_chunk_begin(std::size_t n,
+                                  std::size_t num_chunks,
+                                  std::size_t c) noexcept {
+  return n * c / num_chunks;
+}
+
+// Combines partials[0, count) pairwise in a tree whose shape only depends
+// on count, leaving the result in partials[0].
+template <typename T, typename Op>
+void qt_tree_combine(qt_padded<T> *partials, std::size_t count, Op &op) {
+  for (std::size_t stride = 1; stride < count; stride *= 2) {
+    for (std::size_t i = 0; i + stride < count; i += 2 * stride) {
+      partials[i].value = op(std::move(partials[i].value),
+                             std::move(partials[i + stride].value));
+    }
+  }
+}
+
+// Value completion of a sender that sends the result of a reduction
+// instead of the values of its predecessor.
+template <typename T>
+struct qt_reduce_value {
+  template <class...>
+  using type = stdexec::completion_signatures<stdexec::set_value_t(T)>;
+};
+
+// State shared by the chunks of a single reduce.
+// qt_loop_balance is run over chunk indices rather than elements, so a
+// chunk's bounds don't depend on how qthreads splits the loop.
+template <typename View, typename T, typename Op>
+struct qthreads_reduce_loop {
+  View &range;
+  Op &op;
+  qt_padded<T> *partials;
+  std::size_t num_chunks;
+  std::atomic<bool> const *stop_flag;
+  std::atomic<bool> failed{false};
+  std::exception_ptr error{};
+
+  static void chunk(size_t begin, size_t end, void *arg) {
+    auto *loop = static_cast<qthreads_reduce_loop *>(arg);
+    *qt_stop_flag_slot() = loop->stop_flag;
+    std::size_t n = std::ranges::size(loop->range);
+    auto first = std::ranges::begin(loop->range);
+    try {
+      for (size_t c = begin; c < end; ++c) {
+        std::size_t i = qt_chunk_begin(n, loop->num_chunks, c);
+        std::size_t last = qt_chunk_begin(n, loop->num_chunks, c + 1);
+        // Chunks are never empty, so each starts from its first element
+        // and init only gets folded in once at the end.
+        T acc = first[i];
+        for (++i; i < last; ++i) acc = loop->op(std::move(acc), first[i]);
+        loop->partials[c].value = std::move(acc);
+      }
+    } catch (...) {
+      if (!loop->failed.exchange(true)) {
+        loop->error = std::current_exception();
+      }
+    }
+  }
+};
+
+// Receiver for reduce, connected to the schedule sender of the scheduler
+// passed to reduce. Same as for bulk, the whole reduction runs inside
+// set_value and the calling qthread blocks in qt_loop_balance.
+// The partials are allocated on the first run and kept with the receiver.
+template <class R, class View, class T, class Op>
+class qthreads_reduce_receiver :
+  public stdexec::receiver_adaptor<qthreads_reduce_receiver<R, View, T, Op>,
+                                   R> {
+public:
+  qthreads_reduce_receiver(R r, View range_, T init_, Op op_):
+    stdexec::receiver_adaptor<qthreads_reduce_receiver, R>{std::move(r)},
+    range(std::move(range_)), init(std::move(init_)), op(std::move(op_)) {}
+
+  void set_value() && noexcept {
+    try {
+      std::size_t num_chunks = qt_reduce_chunks(std::ranges::size(range));
+      if (num_chunks == 0) {
+        stdexec::set_value(std::move(*this).base(), std::move(init));
+        return;
+      }
+      if (partials.size() < num_chunks) partials.resize(num_chunks);
+      qthreads_reduce_loop<View, T, Op> loop{
+        range,
+        op,
+        partials.data(),
+        num_chunks,
+        nullptr};
+      {
+        qt_scoped_stop_flag<R> stop(this->base());
+        loop.stop_flag = stop.get();
+        qt_loop_balance(0,
+                        num_chunks,
+                        &decltype(loop)::chunk,
+                        static_cast<void *>(&loop));
+      }
+      if (loop.failed.load()) {
+        stdexec::set_error(std::move(*this).base(), std::move(loop.error));
+        return;
+      }
+      qt_tree_combine(partials.data(), num_chunks, op);
+      T total = op(std::move(init), std::move(partials[0].value));
+      stdexec::set_value(std::move(*this).base(), std::move(total));
+    } catch (...) {
+      stdexec::set_error(std::move(*this).base(), std::current_exception());
+    }
+  }
+private:
+  View range;
+  T init;
+  Op op;
+  std::vector<qt_padded<T>> partials{};
+};
+
+template <stdexec::sender S, typename View, typename T, typename Op>
+struct qthreads_reduce_sender :
+  qthreads_base_sender<qthreads_reduce_sender<S, View, T, Op>> {
+  S s;
+  View range;
+  T init;
+  Op op;
+
+  template <class Env>
+  using completions_t = stdexec::transform_completion_signatures_of<
+    S,
+    Env,
+    stdexec::completion_signatures<stdexec::set_error_t(std::exception_ptr)>,
+    qt_reduce_value<T>::template type>;
+
+  template <class Env>
+  auto get_completion_signatures(Env &&) && -> completions_t<Env> {
+    return {};
+  }
+
+  template <stdexec::receiver R>
+    requires stdexec::sender_to<S, qthreads_reduce_receiver<R, View, T, Op>>
+  auto connect(R r) && {
+    using receiver_t = qthreads_reduce_receiver<R, View, T, Op>;
+    return stdexec::connect(std::move(s),
+                            receiver_t{static_cast<R &&>(r),
+                                       std::move(range),
+                                       std::move(init),
+                                       static_cast<Op &&>(op)});
+  }
+};
+
+// Sends op(init, x0 op x1 op ... op xn-1) over the elements of range,
+// computed in parallel on sched. op has to be associative and
+// commutative, as for std::reduce. The result is reproducible from run to
+// run as long as the number of workers stays the same, see above.
+// An lvalue range is referenced, so it has to outlive the operation.
+template <stdexec::scheduler Scheduler,
+          std::ranges::random_access_range Range,
+          typename T,
+          typename Op>
+  requires std::ranges::sized_range<Range>
+auto reduce(Scheduler sched, Range &&range, T init, Op op) {
+  using schedule_t = stdexec::schedule_result_t<Scheduler>;
+  using view_t = std::views::all_t<Range>;
+  return qthreads_reduce_sender<schedule_t, view_t, T, Op>{
+    {},
+    stdexec::schedule(sched),
+    std::views::all(std::forward<Range>(range)),
+    std::move(init),
+    std::move(op)};
+}
+
+} // namespace stdexx
@@ -0,0 +1,158 @@
+#pragma once
+
+#include <stdlib.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <qthreads/stdexec.hpp>
+
+#include <qthread/qthread.h>
+
+namespace stdexx {
+
+// Settings for the qthreads runtime.
+// Qthreads reads its configuration from QT_* environment variables
+// inside qthread_initialize, so these are exported right before that.
+// Anything left unset keeps the qthreads default, or whatever the
+// user already set in the environment.
+struct runtime_config {
+  // Number of shepherds (QT_NUM_SHEPHERDS).
+  std::optional<int> num_shepherds;
+  // Number of workers per shepherd (QT_NUM_WORKERS_PER_SHEPHERD).
+  std::optional<int> workers_per_shepherd;
+  // Stack size in bytes for each qthread (QT_STACK_SIZE).
+  // Most tasks only need a few KiB, so this is worth lowering
+  // when running lots of small tasks.
+  std::optional<std::size_t> stack_size;
+  // Whether workers get pinned to cores (QT_AFFINITY).
+  std::optional<bool> affinity;
+  // How many times an idle worker spins looking for work before it
+  // goes to sleep (QT_SPINCOUNT). Large values keep workers hot for
+  // bursty work, 0 lets them sleep right away.
+  std::optional<std::size_t> spin_count;
+  // Fork a few throwaway tasks at startup that touch their whole
+  // stack, so the first real tasks don't pay for faulting it in.
+  bool prewarm = false;
+};
+
+namespace detail {
+
+inline void qt_setenv(char const *name, std::string const &value) {
+  setenv(name, value.c_str(), 1);
+}
+
+inline void qt_apply_config(runtime_config const &cfg) {
+  if (cfg.num_shepherds) {
+    qt_setenv("QT_NUM_SHEPHERDS", std::to_string(*cfg.num_shepherds));
+  }
+  if (cfg.workers_per_shepherd) {
+    qt_setenv("QT_NUM_WORKERS_PER_SHEPHERD",
+              std::to_string(*cfg.workers_per_shepherd));
+  }
+  if (cfg.stack_size) {
+    qt_setenv("QT_STACK_SIZE", std::to_string(*cfg.stack_size));
+  }
+  if (cfg.affinity) qt_setenv("QT_AFFINITY", *cfg.affinity ? "yes" : "no");
+  if (cfg.spin_count) {
+    qt_setenv("QT_SPINCOUNT", std::to_string(*cfg.spin_count));
+  }
+}
+
+constexpr std::size_t qt_page_size = 4096;
+
+// Touches one page per frame. The write after the recursive call
+// keeps the compiler from turning this into a loop.
+inline void qt_touch_stack(std::size_t pages) {
+  volatile char page[qt_page_size];
+  page[0] = 0;
+  if (pages > 1) qt_touch_stack(pages - 1);
+  page[qt_page_size - 1] = 0;
+}
+
+inline aligned_t qt_prewarm_task(void *arg) {
+  qt_touch_stack(*static_cast<std::size_t *>(arg));
+  return 0;
+}
+
+} // namespace detail
+
+// Owns the qthreads runtime: initializes it with the given config on
+// construction and finalizes it on destruction.
+// Only one can be alive at a time, since qthreads itself is global.
+class runtime {
+public:
+  explicit runtime(runtime_config const &cfg = {}) {
+    if (live().exchange(true)) {
+      throw std::logic_error("stdexx::runtime is already running");
+    }
+    detail::qt_apply_config(cfg);
+
+    auto start = std::chrono::steady_clock::now();
+    int r = qthread_initialize();
+    startup_ = std::chrono::steady_clock::now() - start;
+    if (r != QTHREAD_SUCCESS) {
+      live() = false;
+      throw std::runtime_error("qthread_initialize failed with " +
+                               std::to_string(r));
+    }
+
+    if (cfg.prewarm) {
+      start = std::chrono::steady_clock::now();
+      prewarm();
+      prewarm_ = std::chrono::steady_clock::now() - start;
+    }
+  }
+
+  ~runtime() {
+    qthread_finalize();
+    live() = false;
+  }
+
+  runtime(runtime const &) = delete;
+  runtime &operator=(runtime const &) = delete;
+
+  // Time spent in qthread_initialize.
+  std::chrono::nanoseconds startup_time() const noexcept { return startup_; }
+
+  // Time spent pre-warming stacks, zero if it was not requested.
+  std::chrono::nanoseconds prewarm_time() const noexcept { return prewarm_; }
+
+  int num_shepherds() const noexcept { return qthread_num_shepherds(); }
+
+  int num_workers() const noexcept { return qthread_num_workers(); }
+
+  std::size_t stack_size() const noexcept {
+    return qthread_readstate(STACK_SIZE);
+  }
+
+  qthreads_scheduler get_scheduler() const noexcept { return {}; }
+private:
+  static std::atomic<bool> &live() noexcept {
+    static std::atomic<bool> flag{false};
+    return flag;
+  }
+
+  // Qthreads keeps finished stacks around for reuse, so running a couple
+  // of tasks per worker that fault in most of their stack leaves warm
+  // stacks behind for the real work.
+  void prewarm() {
+    std::size_t pages = stack_size() * 3 / 4 / detail::qt_page_size;
+    if (pages == 0) return;
+    std::vector<aligned_t> febs(2 * num_workers());
+    for (auto &feb : febs) {
+      qthread_fork(&detail::qt_prewarm_task, &pages, &feb);
+    }
+    for (auto &feb : febs) qthread_readFF(NULL, &feb);
+  }
+
+  std::chrono::nanoseconds startup_{0};
+  std::chrono::nanoseconds prewarm_{0};
+};
+
+} // namespace stdexx
@@ -0,0 +1,239 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+#include <qthreads/stdexec.hpp>
+
+namespace stdexx {
+
+template <typename Sender>
+struct qt_shared_state;
+
+// Receiver for the shared work of split and ensure_started.
+template <typename Sender>
+struct qt_shared_receiver {
+  using receiver_concept = stdexec::receiver_t;
+  qt_shared_state<Sender> *state;
+
+  template <class... As>
+  void set_value(As &&...as) noexcept {
+    state->result.set_value(static_cast<As &&>(as)...);
+    state->notify();
+  }
+
+  template <class E>
+  void set_error(E &&e) noexcept {
+    state->result.set_error(static_cast<E &&>(e));
+    state->notify();
+  }
+
+  void set_stopped() noexcept {
+    state->result.set_stopped();
+    state->notify();
+  }
+
+  qthreads_when_all_env get_env() const noexcept {
+    return {state->stop_source.get_token()};
+  }
+};
+
+// State shared between the work of a split or ensure_started and the
+// operations waiting on it. The work is started at most once and
+// publishes its result here before filling the FEB. Every consumer
+// runs in its own qthread and suspends on that FEB with readFF, which
+// leaves it full, so any number of them wake up without a lock and
+// consumers that come late don't wait at all.
+// It's reference counted: one reference per sender, per consumer
+// operation state, and one held by the work while it runs.
+template <typename Sender>
+struct qt_shared_state {
+  using value_t = qt_value_tuple_t<Sender, qthreads_when_all_env>;
+
+  std::atomic<std::size_t> refs{1};
+  std::atomic<bool> started{false};
+  aligned_t feb;
+  stdexec::inplace_stop_source stop_source{};
+  qt_async_result<value_t> result{};
+  stdexec::connect_result_t<Sender, qt_shared_receiver<Sender>> op;
+
+  template <typename Sender_>
+  explicit qt_shared_state(Sender_ &&sndr):
+    op(qt_emplace_from{[&] {
+      return stdexec::connect(static_cast<Sender_ &&>(sndr),
+                              qt_shared_receiver<Sender>{this});
+    }}) {
+    qthread_empty(&feb);
+  }
+
+  // Qthreads keeps an entry for every empty FEB, so one left behind by
+  // work that never got started would leak and could be found again by
+  // whatever gets allocated at this address next.
+  ~qt_shared_state() { qthread_fill(&feb); }
+
+  void add_ref() noexcept { refs.fetch_add(1, std::memory_order_relaxed); }
+
+  void release() noexcept {
+    if (refs.fetch_sub(1, std::memory_order_acq_rel) == 1) delete this;
+  }
+
+  void start_once() noexcept {
+    if (!started.exchange(true)) {
+      add_ref();
+      stdexec::start(op);
+    }
+  }
+
+  // Called from the completion of op.
+  void notify() noexcept {
+    qthread_fill(&feb);
+    release();
+  }
+};
+
+// Operation state for a consumer of a split or ensure_started.
+// Starts the shared work if nobody has yet, waits on the FEB and
+// completes with the result. Split consumers get a copy of the
+// values since there may be others, the single consumer of an
+// ensure_started gets them moved.
+template <typename Sender, typename Receiver, bool Copy>
+struct qt_shared_operation_state :
+  qt_os_base<qt_shared_operation_state<Sender, Receiver, Copy>, Receiver> {
+  qt_shared_state<Sender> *state;
+
+  // Takes over one reference to the state.
+  template <typename Receiver_>
+  qt_shared_operation_state(qt_shared_state<Sender> *state_,
+                            Receiver_ &&receiver):
+    qt_os_base<qt_shared_operation_state<Sender, Receiver, Copy>, Receiver>(
+      std::forward<Receiver_>(receiver)),
+    state(state_) {}
+
+  ~qt_shared_operation_state() {
+    if (state) state->release();
+  }
+
+  static aligned_t task(void *os_void) noexcept {
+    auto *os = static_cast<qt_shared_operation_state *>(os_void);
+    os->state->start_once();
+    qthread_readFF(NULL, &os->state->feb);
+    if constexpr (Copy) {
+      os->state->result.complete_copy(os);
+    } else {
+      std::move(os->state->result).complete(os);
+    }
+    return 0u;
+  }
+};
+
+template <typename Sender>
+using qt_shared_completions = stdexec::completion_signatures<
+  typename qt_set_value_sig<typename qt_shared_state<Sender>::value_t>::type,
+  stdexec::set_error_t(int),
+  stdexec::set_error_t(std::exception_ptr),
+  stdexec::set_stopped_t()>;
+
+// Sender for our customization of stdexec::split.
+// Copies share the same state, and the work runs once, lazily, when the
+// first consumer starts.
+template <typename Sender>
+struct qthreads_split_sender :
+  qthreads_base_sender<qthreads_split_sender<Sender>> {
+  qt_shared_state<Sender> *state;
+
+  using completion_signatures = qt_shared_completions<Sender>;
+
+  explicit qthreads_split_sender(qt_shared_state<Sender> *state_) noexcept:
+    state(state_) {}
+
+  qthreads_split_sender(qthreads_split_sender const &other) noexcept:
+    state(other.state) {
+    if (state) state->add_ref();
+  }
+
+  qthreads_split_sender(qthreads_split_sender &&other) noexcept:
+    state(std::exchange(other.state, nullptr)) {}
+
+  qthreads_split_sender &operator=(qthreads_split_sender other) noexcept {
+    std::swap(state, other.state);
+    return *this;
+  }
+
+  ~qthreads_split_sender() {
+    if (state) state->release();
+  }
+
+  template <typename Receiver>
+  qt_shared_operation_state<Sender, std::remove_cvref_t<Receiver>, true>
+  connect(Receiver &&receiver) const & {
+    state->add_ref();
+    return {state, std::forward<Receiver>(receiver)};
+  }
+
+  template <typename Receiver>
+  qt_shared_operation_state<Sender, std::remove_cvref_t<Receiver>, true>
+  connect(Receiver &&receiver) && {
+    return {std::exchange(state, nullptr), std::forward<Receiver>(receiver)};
+  }
+};
+
+// Sender for our customization of stdexec::ensure_started.
+// The work is started right away, and this is its only consumer.
+// Dropping it without connecting requests stop on the work.
+template <typename Sender>
+struct qthreads_ensure_started_sender :
+  qthreads_base_sender<qthreads_ensure_started_sender<Sender>> {
+  qt_shared_state<Sender> *state;
+
+  using completion_signatures = qt_shared_completions<Sender>;
+
+  explicit qthreads_ensure_started_sender(
+    qt_shared_state<Sender> *state_) noexcept:
+    state(state_) {
+    state->start_once();
+  }
+
+  qthreads_ensure_started_sender(
+    qthreads_ensure_started_sender &&other) noexcept:
+    state(std::exchange(other.state, nullptr)) {}
+
+  ~qthreads_ensure_started_sender() {
+    if (state) {
+      state->stop_source.request_stop();
+      state->release();
+    }
+  }
+
+  template <typename Receiver>
+  qt_shared_operation_state<Sender, std::remove_cvref_t<Receiver>, false>
+  connect(Receiver &&receiver) && {
+    return {std::exchange(state, nullptr), std::forward<Receiver>(receiver)};
+  }
+};
+
+// Our transform_sender override calls into these for implementing
+// stdexec::split and stdexec::ensure_started on qthreads senders.
+template <>
+struct transform_sender_for<stdexec::split_t> {
+  template <class Sender>
+    requires is_qthreads_sender<std::remove_cvref_t<Sender>>
+  auto operator()(stdexec::__ignore, stdexec::__ignore, Sender &&sndr) const {
+    using sender_t = std::remove_cvref_t<Sender>;
+    return qthreads_split_sender<sender_t>{
+      new qt_shared_state<sender_t>(static_cast<Sender &&>(sndr))};
+  }
+};
+
+template <>
+struct transform_sender_for<stdexec::ensure_started_t> {
+  template <class Sender>
+    requires is_qthreads_sender<std::remove_cvref_t<Sender>>
+  auto operator()(stdexec::__ignore, stdexec::__ignore, Sender &&sndr) const {
+    using sender_t = std::remove_cvref_t<Sender>;
+    return qthreads_ensure_started_sender<sender_t>{
+      new qt_shared_state<sender_t>(static_cast<Sender &&>(sndr))};
+  }
+};
+
+} // namespace stdexx
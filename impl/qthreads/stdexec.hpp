@@ -1,18 +1,29 @@
-#define once
+#pragma once
 
 #include <stdio.h>
 
+#include <atomic>
 #include <concepts>
+#include <exception>
 #include <iostream>
+#include <optional>
+#include <system_error>
+#include <tuple>
 #include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
 
 #include <stdexec/execution.hpp>
 
 #include <qthread/qloop.h>
 #include <qthread/qthread.h>
+#include <qthread/sinc.h>
 
 namespace stdexx {
 
+// Bare init/finalize with the qthreads defaults. See stdexx::runtime
+// in runtime.hpp for a configurable RAII version.
 int init() { return qthread_initialize(); }
 
 void finalize() { qthread_finalize(); }
@@ -34,9 +45,14 @@ template <typename Val>
 struct qthreads_just_sender;
 template <typename Func>
 struct qthreads_basic_func_sender;
-template <typename Func, typename Arg>
+template <typename Func, typename... Args>
 struct qthreads_func_sender;
 
+struct qthreads_shepherd_scheduler;
+struct qthreads_shepherd_sender;
+struct qthreads_stack_scheduler;
+struct qthreads_stack_sender;
+
 template <class Tag, class... Env>
 struct transform_sender_for;
 
@@ -82,6 +98,45 @@ struct qthreads_domain {
   }
 };
 
+// Query for the shepherd associated with a scheduler or env.
+// For the env of a sender this is the shepherd its work is sent to,
+// or the shepherd of the calling qthread when it isn't pinned anywhere.
+struct get_shepherd_t {
+  template <class Env>
+    requires stdexec::tag_invocable<get_shepherd_t, Env const &>
+  qthread_shepherd_id_t operator()(Env const &env) const noexcept {
+    return stdexec::tag_invoke(*this, env);
+  }
+};
+
+inline constexpr get_shepherd_t get_shepherd{};
+
+// Stack classes for the qthreads forked by an operation state.
+// Qthreads has a single stack size per runtime, so these are the two
+// classes it can offer:
+// - large: a regular qthread with its own stack, sized by
+//   runtime_config::stack_size (QT_STACK_SIZE). This is the default.
+// - small: a simple qthread (QTHREAD_SPAWN_SIMPLE) that has no stack of
+//   its own and runs on the stack of the worker that picks it up. It
+//   only costs the task struct, but it has to run to completion without
+//   blocking, so it's meant for leaf work: no bulk, FEB waits, nested
+//   sync_wait or stop_requested() inside it.
+// A smaller stack for blocking tasks isn't on offer, so the suspended
+// parents of a recursive decomposition always pay for a large stack.
+// Small only saves memory on the leaves they wait on.
+enum class stack_class { large, small };
+
+// Query for the stack class of a scheduler or env.
+struct get_stack_class_t {
+  template <class Env>
+    requires stdexec::tag_invocable<get_stack_class_t, Env const &>
+  stack_class operator()(Env const &env) const noexcept {
+    return stdexec::tag_invoke(*this, env);
+  }
+};
+
+inline constexpr get_stack_class_t get_stack_class{};
+
 // Scheduler type usable with stdexec APIs.
 // In our case it's mostly trivial since the qthreads scheduler
 // is a static thing that (of necessity) has to be initialized/deinitialized
@@ -103,20 +158,130 @@ struct qthreads_scheduler {
   qthreads_sender schedule() const noexcept;
 };
 
+// Per-qthread slot holding the cancellation flag of the operation state
+// whose task is currently running, see stop_requested() below.
+// It lives in qthreads task-local storage so it follows the ULT
+// across yields and migrations.
+inline std::atomic<bool> const **qt_stop_flag_slot() noexcept {
+  return static_cast<std::atomic<bool> const **>(
+    qthread_get_tasklocal(sizeof(std::atomic<bool> const *)));
+}
+
+// Set while a small stack class task runs on this worker. Simple
+// qthreads have no task-local storage, but they never yield either, so
+// a plain thread_local is enough to tell that the slot can't be used.
+inline thread_local bool qt_in_simple_task = false;
+
+// Whether the caller runs in a qthread that has a stop flag slot.
+inline bool qt_has_stop_flag_slot() noexcept {
+  return !qt_in_simple_task && qthread_shep() != NO_SHEPHERD;
+}
+
+// Cheap cancellation check for work running inside a qthreads task,
+// e.g. the invocable passed to then, bulk or a func sender.
+// This is a relaxed load of a flag set by the stop callback registered
+// in the operation state, so it can be polled in inner loops.
+// Returns false when called from outside of a qthread.
+inline bool stop_requested() noexcept {
+  if (!qt_has_stop_flag_slot()) return false;
+  auto const *flag = *qt_stop_flag_slot();
+  return flag && flag->load(std::memory_order_relaxed);
+}
+
+// Stop callback registered by qt_os_base. It only marks the operation
+// as cancelled, the qthread notices it once it runs.
+struct qt_on_stop {
+  std::atomic<bool> *cancelled;
+
+  void operator()() const noexcept {
+    cancelled->store(true, std::memory_order_relaxed);
+  }
+};
+
+// Stop flag for the work an adaptor runs inside set_value, e.g. the
+// invocable of then or the chunks of bulk.
+// The operation state that forked the qthread deregisters its own flag
+// before it completes, since its receiver's env is only valid until
+// then. So the adaptor takes the stop token from the env of the receiver
+// it completes to instead, registers a flag on it for as long as the
+// work runs, and points the task-local slot at that flag so that
+// stop_requested() sees it. It has to go out of scope before that
+// receiver gets completed, which also puts the slot back.
+template <class Receiver>
+class qt_scoped_stop_flag {
+  using stop_token_t = stdexec::stop_token_of_t<stdexec::env_of_t<Receiver>>;
+  using stop_callback_t =
+    stdexec::stop_callback_for_t<stop_token_t, qt_on_stop>;
+public:
+  explicit qt_scoped_stop_flag(Receiver const &r) noexcept {
+    if constexpr (!stdexec::unstoppable_token<stop_token_t>) {
+      on_stop.emplace(stdexec::get_stop_token(stdexec::get_env(r)),
+                      qt_on_stop{&flag});
+    }
+    if (qt_has_stop_flag_slot()) {
+      slot = qt_stop_flag_slot();
+      saved = std::exchange(*slot, &flag);
+    }
+  }
+
+  ~qt_scoped_stop_flag() {
+    if (slot) *slot = saved;
+  }
+
+  qt_scoped_stop_flag(qt_scoped_stop_flag const &) = delete;
+  qt_scoped_stop_flag &operator=(qt_scoped_stop_flag const &) = delete;
+
+  std::atomic<bool> const *get() const noexcept { return &flag; }
+private:
+  std::atomic<bool> flag{false};
+  std::optional<stop_callback_t> on_stop{};
+  std::atomic<bool> const **slot = nullptr;
+  std::atomic<bool> const *saved = nullptr;
+};
+
 // CRTP type used by the various operation states.
-// This implements the qthread_fork call and stores the FEB.
-// The associated qthread_readFF call happens during sync_wait
-// whenever waiting on an associated qthreads sender.
+// This implements the qthread_fork call.
 // The types that subclass from this one provide a static
 // function that gets passed th qthread_fork as well as any
 // additional init/deinit they may need.
+// Note: the qthread is forked without a return value FEB.
+// Completion is signaled through the receiver (see sync_wait),
+// and the operation state may already be gone by the time
+// the qthread returns, so nothing may be written into it then.
+// The operation state can optionally be pinned to a shepherd, in which case
+// qthread_fork_to is used instead so the work stays close to its data.
+// Small stack class tasks go through qthread_spawn as simple qthreads,
+// see stack_class above.
+// While the qthread is queued or running, a stop callback is registered
+// with the receiver's stop token. A task that gets cancelled before it's
+// dequeued completes with set_stopped without running. A running task
+// can poll stdexx::stop_requested().
+// Subclasses complete through the complete_* helpers, which deregister
+// the stop callback before the receiver is invoked. Work that runs
+// inside that receiver, e.g. then or bulk, gets its stop flag from a
+// qt_scoped_stop_flag instead.
 template <typename Derived_Op_State, typename Receiver>
 struct qt_os_base {
-  aligned_t feb;
+  using stop_token_t = stdexec::stop_token_of_t<stdexec::env_of_t<Receiver>>;
+  using stop_callback_t =
+    stdexec::stop_callback_for_t<stop_token_t, qt_on_stop>;
+
   Receiver receiver;
+  qthread_shepherd_id_t shep;
+  stack_class stack;
+  std::atomic<bool> cancelled{false};
+  std::optional<stop_callback_t> on_stop{};
+
+  template <typename Receiver_>
+  qt_os_base(Receiver_ &&r):
+    receiver(std::forward<Receiver_>(r)), shep(NO_SHEPHERD),
+    stack(stack_class::large) {}
 
   template <typename Receiver_>
-  qt_os_base(Receiver_ &&r): feb(0u), receiver(std::forward<Receiver_>(r)) {}
+  qt_os_base(Receiver_ &&r,
+             qthread_shepherd_id_t shep_,
+             stack_class stack_ = stack_class::large):
+    receiver(std::forward<Receiver_>(r)), shep(shep_), stack(stack_) {}
 
   qt_os_base(qt_os_base &&) = delete;
   qt_os_base(qt_os_base const &) = delete;
@@ -129,11 +294,70 @@ struct qt_os_base {
       stdexec::set_stopped(std::move(receiver));
       return;
     }
-    int r = qthread_fork(&Derived_Op_State::task, this, &feb);
+    if constexpr (!stdexec::unstoppable_token<stop_token_t>) {
+      on_stop.emplace(st, qt_on_stop{&cancelled});
+    }
+    int r;
+    if (stack == stack_class::small) {
+      r = qthread_spawn(&qt_os_base::run,
+                        this,
+                        0,
+                        NULL,
+                        0,
+                        NULL,
+                        shep,
+                        QTHREAD_SPAWN_SIMPLE);
+    } else {
+      r = shep == NO_SHEPHERD
+            ? qthread_fork(&qt_os_base::run, this, NULL)
+            : qthread_fork_to(&qt_os_base::run, this, NULL, shep);
+    }
+
+    if (r != QTHREAD_SUCCESS) complete_error(r);
+  }
+
+  template <typename... As>
+  void complete_value(As &&...as) noexcept {
+    release();
+    stdexec::set_value(std::move(receiver), static_cast<As &&>(as)...);
+  }
+
+  template <typename E>
+  void complete_error(E &&e) noexcept {
+    release();
+    stdexec::set_error(std::move(receiver), static_cast<E &&>(e));
+  }
+
+  void complete_stopped() noexcept {
+    release();
+    stdexec::set_stopped(std::move(receiver));
+  }
+private:
+  // Entry point of the forked qthread.
+  static aligned_t run(void *arg) noexcept {
+    auto *os = static_cast<Derived_Op_State *>(arg);
+    if (os->cancelled.load(std::memory_order_relaxed)) {
+      os->complete_stopped();
+      return 0u;
+    }
+    // Simple qthreads don't get task-local storage.
+    if (os->stack == stack_class::small) {
+      qt_in_simple_task = true;
+      aligned_t r = Derived_Op_State::task(os);
+      qt_in_simple_task = false;
+      return r;
+    }
+    *qt_stop_flag_slot() = &os->cancelled;
+    return Derived_Op_State::task(os);
+  }
 
-    if (r != QTHREAD_SUCCESS) {
-      stdexec::set_error(std::move(this->receiver), r);
+  // This can also run on some other qthread, e.g. a timer that gets
+  // cancelled from a stop callback, so only our own flag is cleared.
+  void release() noexcept {
+    if (qt_has_stop_flag_slot() && *qt_stop_flag_slot() == &cancelled) {
+      *qt_stop_flag_slot() = nullptr;
     }
+    on_stop.reset();
   }
 };
 
@@ -146,7 +370,7 @@ template <typename Receiver>
 struct operation_state : qt_os_base<operation_state<Receiver>, Receiver> {
   static aligned_t task(void *arg) noexcept {
     auto *os = static_cast<operation_state *>(arg);
-    stdexec::set_value(std::move(os->receiver));
+    os->complete_value();
     return 0u;
   }
 };
@@ -169,36 +393,75 @@ struct just_operation_state :
   static aligned_t task(void *os_void) noexcept {
     just_operation_state *os =
       reinterpret_cast<just_operation_state *>(os_void);
-    stdexec::set_value(std::move(os->receiver), std::move(os->val));
+    os->complete_value(std::move(os->val));
     return 0u;
   }
 };
 
+// Value completion signature for the func senders.
+// The result of the invocable is sent by value, or nothing for void.
+// An invocable returning a reference sends a copy of the referenced
+// object, since nothing guarantees it outlives the operation.
+template <typename Ret>
+struct qt_func_value_sig {
+  using type = stdexec::set_value_t(std::remove_cvref_t<Ret>);
+};
+
+template <>
+struct qt_func_value_sig<void> {
+  using type = stdexec::set_value_t();
+};
+
+template <typename Ret>
+using qt_func_completions =
+  stdexec::completion_signatures<typename qt_func_value_sig<Ret>::type,
+                                 stdexec::set_stopped_t(),
+                                 stdexec::set_error_t(int),
+                                 stdexec::set_error_t(std::exception_ptr)>;
+
+// Invokes func with the given arguments inside the running qthread and
+// completes the operation state with the result.
+// Exceptions thrown by func are forwarded through set_error.
+template <typename Os, typename Func, typename Args>
+void qt_invoke_and_complete(Os *os, Func &&func, Args &&args) noexcept {
+  using ret_t = decltype(std::apply(static_cast<Func &&>(func),
+                                    static_cast<Args &&>(args)));
+  try {
+    if constexpr (std::is_void_v<ret_t>) {
+      std::apply(static_cast<Func &&>(func), static_cast<Args &&>(args));
+      os->complete_value();
+    } else {
+      // Matches qt_func_value_sig, a returned reference is copied.
+      using value_t = std::remove_cvref_t<ret_t>;
+      os->complete_value(static_cast<value_t>(
+        std::apply(static_cast<Func &&>(func), static_cast<Args &&>(args))));
+    }
+  } catch (...) {
+    os->complete_error(std::current_exception());
+  }
+}
+
 // Operation state for a qthreads sender type that
-// encapsulates an invocable with an associated single argument.
-// TODO: multiple arguments? Thus far I got hung up on
-// some kind of issue preventing expanding parameter packs
-// as struct members.
-template <typename Func, typename Arg, typename Receiver>
+// encapsulates an invocable with its associated arguments.
+// The arguments are stored in place and moved into the call,
+// since the operation state only ever runs the invocable once.
+template <typename Func, typename Args, typename Receiver>
 struct func_operation_state :
-  qt_os_base<func_operation_state<Func, Arg, Receiver>, Receiver> {
+  qt_os_base<func_operation_state<Func, Args, Receiver>, Receiver> {
   Func func;
-  Arg arg;
+  Args args;
 
-  template <typename Func_, typename Arg_, typename Receiver_>
-  func_operation_state(Func_ &&f, Arg_ &&a, Receiver_ &&receiver):
-    qt_os_base<func_operation_state<Func, Arg, Receiver>, Receiver>(
+  template <typename Func_, typename Args_, typename Receiver_>
+  func_operation_state(Func_ &&f, Args_ &&a, Receiver_ &&receiver):
+    qt_os_base<func_operation_state<Func, Args, Receiver>, Receiver>(
       std::forward<Receiver_>(receiver)),
-    func(std::forward<Func_>(f)), arg(std::forward<Arg_>(a)) {}
+    func(std::forward<Func_>(f)), args(std::forward<Args_>(a)) {}
 
   static aligned_t task(void *os_void) noexcept {
-    // TODO: we can probably forward C++ exceptions out of here. Figure out
-    // how.
     func_operation_state *os =
       reinterpret_cast<func_operation_state *>(os_void);
-    aligned_t ret = (os->func)(os->arg);
-    stdexec::set_value(std::move(os->receiver), ret);
-    return ret;
+    qt_invoke_and_complete(os, std::move(os->func), std::move(os->args));
+    return 0u;
   }
 };
 
@@ -216,13 +479,10 @@ struct basic_func_operation_state :
     func(std::forward<Func_>(f)) {}
 
   static aligned_t task(void *os_void) noexcept {
-    // TODO: we can probably forward C++ exceptions out of here. Figure out
-    // how.
     basic_func_operation_state *os =
       reinterpret_cast<basic_func_operation_state *>(os_void);
-    aligned_t ret = (os->func)();
-    stdexec::set_value(std::move(os->receiver), ret);
-    return ret;
+    qt_invoke_and_complete(os, std::move(os->func), std::tuple<>{});
+    return 0u;
   }
 };
 
@@ -234,6 +494,12 @@ struct qthreads_env {
 
   friend qthreads_domain tag_invoke(stdexec::get_domain_t const,
                                     qthreads_env const &) noexcept;
+
+  // Unpinned senders report whichever shepherd is running the caller.
+  friend qthread_shepherd_id_t tag_invoke(get_shepherd_t const,
+                                          qthreads_env const &) noexcept {
+    return qthread_shep();
+  }
 };
 
 // CRTP base class for various qthreads sender types.
@@ -261,19 +527,25 @@ struct qthreads_sender : qthreads_base_sender<qthreads_sender> {
                                    stdexec::set_error_t(int)>;
 
   template <typename Receiver>
-  operation_state<Receiver> connect(Receiver &&receiver) && {
+  operation_state<std::remove_cvref_t<Receiver>>
+  connect(Receiver &&receiver) && {
     return {std::forward<Receiver>(receiver)};
   }
 };
 
-// Qthreads ender type wrapping a single value.
-// Note: the value is moved into this struct and will be moved
+// Qthreads sender type wrapping a single value.
+// Note: the value is forwarded into this struct and will be moved
 // again into the operation state and then into the set_value call.
+// It's never copied, so move-only values work too.
 template <typename Val>
 struct qthreads_just_sender : qthreads_base_sender<qthreads_just_sender<Val>> {
   Val val;
 
-  qthreads_just_sender(Val &&v) noexcept: val(v) {}
+  template <typename Val_>
+    requires std::constructible_from<Val, Val_>
+  qthreads_just_sender(Val_ &&v) noexcept(
+    std::is_nothrow_constructible_v<Val, Val_>):
+    val(std::forward<Val_>(v)) {}
 
   using completion_signatures =
     stdexec::completion_signatures<stdexec::set_value_t(Val &&),
@@ -281,94 +553,244 @@ struct qthreads_just_sender : qthreads_base_sender<qthreads_just_sender<Val>> {
                                    stdexec::set_error_t(int)>;
 
   template <typename Receiver>
-  static just_operation_state<Val, Receiver> connect(qthreads_just_sender &&s,
-                                                     Receiver &&receiver) {
+  static just_operation_state<Val, std::remove_cvref_t<Receiver>>
+  connect(qthreads_just_sender &&s, Receiver &&receiver) {
     return {std::move(s.val), std::forward<Receiver>(receiver)};
   }
 };
 
+template <typename Val>
+qthreads_just_sender(Val &&) -> qthreads_just_sender<std::decay_t<Val>>;
+
 // Qthreads sender type wrapping a bare function call.
-// Note: the func is moved into this struct and will be moved
+// Note: the func is forwarded into this struct and will be moved
 // again into the operation state.
 template <typename Func>
 struct qthreads_basic_func_sender :
   qthreads_base_sender<qthreads_basic_func_sender<Func>> {
   Func func;
 
-  qthreads_basic_func_sender(Func &&f) noexcept: func(f) {}
+  template <typename Func_>
+    requires std::constructible_from<Func, Func_>
+  qthreads_basic_func_sender(Func_ &&f) noexcept(
+    std::is_nothrow_constructible_v<Func, Func_>):
+    func(std::forward<Func_>(f)) {}
 
-  using completion_signatures =
-    stdexec::completion_signatures<stdexec::set_value_t(aligned_t),
-                                   stdexec::set_stopped_t(),
-                                   stdexec::set_error_t(int)>;
+  using completion_signatures = qt_func_completions<std::invoke_result_t<Func>>;
 
   template <typename Receiver>
-  static basic_func_operation_state<Func, Receiver>
+  static basic_func_operation_state<Func, std::remove_cvref_t<Receiver>>
   connect(qthreads_basic_func_sender &&s, Receiver &&receiver) {
     return {std::move(s.func), std::forward<Receiver>(receiver)};
   }
 };
 
-// Qthreads sender type wrapping a call to a function with an argument.
-// The func and arg are moved into this struct and will be moved into the
-// operation state.
-template <typename Func, typename Arg>
+template <typename Func>
+qthreads_basic_func_sender(Func &&)
+  -> qthreads_basic_func_sender<std::decay_t<Func>>;
+
+// Qthreads sender type wrapping a call to a function with any number
+// of arguments, e.g. qthreads_func_sender(f, a, b).
+// The func and args are forwarded into this struct and will be moved into
+// the operation state. The result of the call is sent by value.
+template <typename Func, typename... Args>
 struct qthreads_func_sender :
-  qthreads_base_sender<qthreads_func_sender<Func, Arg>> {
+  qthreads_base_sender<qthreads_func_sender<Func, Args...>> {
   Func func;
-  Arg arg;
+  std::tuple<Args...> args;
 
-  qthreads_func_sender(Func f, Arg a) noexcept: func(f), arg(a) {}
+  template <typename Func_, typename... Args_>
+    requires std::constructible_from<Func, Func_> &&
+             (sizeof...(Args_) == sizeof...(Args))
+  qthreads_func_sender(Func_ &&f, Args_ &&...a) noexcept(
+    std::is_nothrow_constructible_v<Func, Func_> &&
+    (std::is_nothrow_constructible_v<Args, Args_> && ...)):
+    func(std::forward<Func_>(f)), args(std::forward<Args_>(a)...) {}
 
   using completion_signatures =
-    stdexec::completion_signatures<stdexec::set_value_t(aligned_t),
-                                   stdexec::set_stopped_t(),
-                                   stdexec::set_error_t(int)>;
+    qt_func_completions<std::invoke_result_t<Func, Args...>>;
 
   template <typename Receiver>
-  static func_operation_state<Func, Arg, Receiver>
+  static func_operation_state<Func,
+                              std::tuple<Args...>,
+                              std::remove_cvref_t<Receiver>>
   connect(qthreads_func_sender &&s, Receiver &&receiver) {
     return {
-      std::move(s.func), std::move(s.arg), std::forward<Receiver>(receiver)};
+      std::move(s.func), std::move(s.args), std::forward<Receiver>(receiver)};
   }
 };
 
+template <typename Func, typename... Args>
+qthreads_func_sender(Func &&, Args &&...)
+  -> qthreads_func_sender<std::decay_t<Func>, std::decay_t<Args>...>;
+
 // This provides the scheduler's customization for stdexec::schedule.
 // It just needs to be defined down here for order of definition reasons.
 qthreads_sender qthreads_scheduler::schedule() const noexcept { return {}; }
 
-// A helper type for our implementation of stdexec::then.
-// The example implementation of then in the stdexec repo
-// doesn't actually handle void return types correctly
-// in its templating idioms.
-// On the other hand, the actual implementation for stdexec::then
-// has a bunch of internal interface calls instead of just
-// using specified ones. This struct type exists as a templating
-// tool so we can compile the associated set_value call
-// after we've determined whether the invocable passed to
-// then returns void.
-template <bool returns_void>
-struct set_value_impl;
+// Scheduler that forks all of its work onto one specific shepherd
+// with qthread_fork_to instead of letting qthreads place it.
+// Use shepherd_schedulers() to get one per shepherd, e.g. to keep
+// the chunks of a vector on the shepherd that first touched them.
+struct qthreads_shepherd_scheduler {
+  qthread_shepherd_id_t shep;
 
-template <>
-struct set_value_impl<true> {
-  template <typename Rec, typename Func, typename... Args>
-  static decltype(auto) impl(Rec &&rec, Func &&func, Args &&...args) {
-    std::invoke(std::move(func), static_cast<Args &&>(args)...);
-    stdexec::set_value(std::move(rec));
+  friend qthreads_domain tag_invoke(stdexec::get_domain_t const,
+                                    qthreads_shepherd_scheduler const &) noexcept {
+    return {};
   }
+
+  friend qthread_shepherd_id_t
+  tag_invoke(get_shepherd_t const,
+             qthreads_shepherd_scheduler const &sched) noexcept {
+    return sched.shep;
+  }
+
+  bool operator==(qthreads_shepherd_scheduler const &rhs) const noexcept {
+    return shep == rhs.shep;
+  }
+
+  bool operator!=(qthreads_shepherd_scheduler const &rhs) const noexcept {
+    return !(*this == rhs);
+  }
+
+  qthreads_shepherd_sender schedule() const noexcept;
 };
 
-template <>
-struct set_value_impl<false> {
-  template <typename Rec, typename Func, typename... Args>
-  static decltype(auto) impl(Rec &&rec, Func &&func, Args &&...args) {
-    return stdexec::set_value(
-      std::move(rec),
-      std::invoke(static_cast<Func &&>(func), static_cast<Args &&>(args)...));
+// Env for senders pinned to a shepherd.
+struct qthreads_shepherd_env {
+  qthread_shepherd_id_t shep;
+
+  friend qthreads_domain tag_invoke(stdexec::get_domain_t const,
+                                    qthreads_shepherd_env const &) noexcept {
+    return {};
+  }
+
+  friend qthread_shepherd_id_t
+  tag_invoke(get_shepherd_t const, qthreads_shepherd_env const &env) noexcept {
+    return env.shep;
+  }
+
+  friend qthreads_shepherd_scheduler
+  tag_invoke(stdexec::get_completion_scheduler_t<stdexec::set_value_t> const,
+             qthreads_shepherd_env const &env) noexcept {
+    return {env.shep};
+  }
+};
+
+// Sender returned by stdexec::schedule(qthreads_shepherd_scheduler).
+// Same as qthreads_sender except for where the qthread gets forked.
+struct qthreads_shepherd_sender :
+  qthreads_base_sender<qthreads_shepherd_sender> {
+  qthread_shepherd_id_t shep;
+
+  using completion_signatures =
+    stdexec::completion_signatures<stdexec::set_value_t(),
+                                   stdexec::set_stopped_t(),
+                                   stdexec::set_error_t(int)>;
+
+  qthreads_shepherd_env get_env() const noexcept { return {shep}; }
+
+  template <typename Receiver>
+  operation_state<std::remove_cvref_t<Receiver>>
+  connect(Receiver &&receiver) && {
+    return {{std::forward<Receiver>(receiver), shep}};
   }
 };
 
+qthreads_shepherd_sender qthreads_shepherd_scheduler::schedule() const noexcept {
+  return {{}, shep};
+}
+
+// One scheduler per shepherd, indexed by shepherd id.
+// Only valid after the runtime has been initialized.
+std::vector<qthreads_shepherd_scheduler> shepherd_schedulers() {
+  std::vector<qthreads_shepherd_scheduler> scheds;
+  qthread_shepherd_id_t n = qthread_num_shepherds();
+  scheds.reserve(n);
+  for (qthread_shepherd_id_t i = 0; i < n; ++i) scheds.push_back({i});
+  return scheds;
+}
+
+// Scheduler that forks all of its work with the given stack class.
+// Small is meant for the leaves of wide or deep decompositions that
+// queue huge numbers of tasks at once, never for their parents, e.g.
+//   stdexec::schedule(qthreads_stack_scheduler{stack_class::small})
+//     | stdexec::then(tiny_leaf)
+struct qthreads_stack_scheduler {
+  stack_class stack;
+
+  friend qthreads_domain tag_invoke(stdexec::get_domain_t const,
+                                    qthreads_stack_scheduler const &) noexcept {
+    return {};
+  }
+
+  friend stack_class
+  tag_invoke(get_stack_class_t const,
+             qthreads_stack_scheduler const &sched) noexcept {
+    return sched.stack;
+  }
+
+  bool operator==(qthreads_stack_scheduler const &rhs) const noexcept {
+    return stack == rhs.stack;
+  }
+
+  bool operator!=(qthreads_stack_scheduler const &rhs) const noexcept {
+    return !(*this == rhs);
+  }
+
+  qthreads_stack_sender schedule() const noexcept;
+};
+
+// Env for senders forked with a given stack class.
+struct qthreads_stack_env {
+  stack_class stack;
+
+  friend qthreads_domain tag_invoke(stdexec::get_domain_t const,
+                                    qthreads_stack_env const &) noexcept {
+    return {};
+  }
+
+  friend stack_class tag_invoke(get_stack_class_t const,
+                                qthreads_stack_env const &env) noexcept {
+    return env.stack;
+  }
+
+  friend qthread_shepherd_id_t tag_invoke(get_shepherd_t const,
+                                          qthreads_stack_env const &) noexcept {
+    return qthread_shep();
+  }
+
+  friend qthreads_stack_scheduler
+  tag_invoke(stdexec::get_completion_scheduler_t<stdexec::set_value_t> const,
+             qthreads_stack_env const &env) noexcept {
+    return {env.stack};
+  }
+};
+
+// Sender returned by stdexec::schedule(qthreads_stack_scheduler).
+// Same as qthreads_sender except for how the qthread gets forked.
+struct qthreads_stack_sender : qthreads_base_sender<qthreads_stack_sender> {
+  stack_class stack;
+
+  using completion_signatures =
+    stdexec::completion_signatures<stdexec::set_value_t(),
+                                   stdexec::set_stopped_t(),
+                                   stdexec::set_error_t(int)>;
+
+  qthreads_stack_env get_env() const noexcept { return {stack}; }
+
+  template <typename Receiver>
+  operation_state<std::remove_cvref_t<Receiver>>
+  connect(Receiver &&receiver) && {
+    return {{std::forward<Receiver>(receiver), NO_SHEPHERD, stack}};
+  }
+};
+
+qthreads_stack_sender qthreads_stack_scheduler::schedule() const noexcept {
+  return {{}, stack};
+}
+
 // Another helper type to generate the completion signatures
 // depending on whether the invocable passed to our "then" customization
 // returns void or not.
@@ -412,9 +834,23 @@ public:
   template <class... As>
     requires stdexec::receiver_of<R, _completions<As...>>
   void set_value(As &&...as) && noexcept {
+    // f runs with a stop flag of its own, which is gone again by the
+    // time the result is passed on.
     try {
-      set_value_impl<std::is_same_v<ret_t<As...>, void>>::impl(
-        std::move(*this).base(), std::move(f), static_cast<As &&>(as)...);
+      if constexpr (std::is_same_v<ret_t<As...>, void>) {
+        {
+          qt_scoped_stop_flag<R> stop(this->base());
+          std::invoke(std::move(f), static_cast<As &&>(as)...);
+        }
+        stdexec::set_value(std::move(*this).base());
+      } else {
+        ret_t<As...> result = [&]() -> ret_t<As...> {
+          qt_scoped_stop_flag<R> stop(this->base());
+          return std::invoke(std::move(f), static_cast<As &&>(as)...);
+        }();
+        stdexec::set_value(std::move(*this).base(),
+                           static_cast<ret_t<As...> &&>(result));
+      }
     } catch (...) {
       stdexec::set_error(std::move(*this).base(), std::current_exception());
     }
@@ -492,38 +928,587 @@ struct transform_sender_for<stdexec::then_t> {
   }
 };
 
+// State shared by all the chunks of a single bulk invocation.
+// qt_loop_balance hands each worker one contiguous [begin, end) slice
+// of the iteration space and only returns once every slice has run,
+// so this can live on the stack of the qthread that calls set_value.
+// The values sent by the predecessor are passed to the invocable
+// by lvalue reference, same as stdexec::bulk does.
+template <typename Shape, typename F, typename... As>
+struct qthreads_bulk_loop {
+  F &f;
+  std::tuple<As &...> args;
+  // Stop flag registered by the bulk receiver, so that
+  // stop_requested() works from inside the chunks too.
+  std::atomic<bool> const *stop_flag;
+  std::atomic<bool> failed{false};
+  std::exception_ptr error{};
+
+  static void chunk(size_t begin, size_t end, void *arg) {
+    auto *loop = static_cast<qthreads_bulk_loop *>(arg);
+    *qt_stop_flag_slot() = loop->stop_flag;
+    try {
+      std::apply(
+        [&](As &...as) {
+          for (size_t i = begin; i < end; ++i) {
+            loop->f(static_cast<Shape>(i), as...);
+          }
+        },
+        loop->args);
+    } catch (...) {
+      // Only the first exception is kept, the rest are dropped.
+      if (!loop->failed.exchange(true)) {
+        loop->error = std::current_exception();
+      }
+    }
+  }
+};
+
+// Receiver for our customization of stdexec::bulk.
+// Like the then receiver, all the work happens inside set_value,
+// which runs inside the qthread that completed the predecessor.
+// That qthread blocks in qt_loop_balance until the whole iteration
+// space is done, which is the single join point for the bulk.
+template <class R, class Shape, class F>
+class qthreads_bulk_receiver :
+  public stdexec::receiver_adaptor<qthreads_bulk_receiver<R, Shape, F>, R> {
+public:
+  qthreads_bulk_receiver(R r, Shape shape_, F f_):
+    stdexec::receiver_adaptor<qthreads_bulk_receiver, R>{std::move(r)},
+    shape(shape_), f(std::move(f_)) {}
+
+  template <class... As>
+  void set_value(As &&...as) && noexcept {
+    qthreads_bulk_loop<Shape, F, std::remove_reference_t<As>...> loop{
+      f, {as...}, nullptr};
+    {
+      qt_scoped_stop_flag<R> stop(this->base());
+      loop.stop_flag = stop.get();
+      if (shape > Shape(0)) {
+        qt_loop_balance(0,
+                        static_cast<size_t>(shape),
+                        &decltype(loop)::chunk,
+                        static_cast<void *>(&loop));
+      }
+    }
+    if (loop.failed.load()) {
+      stdexec::set_error(std::move(*this).base(), std::move(loop.error));
+    } else {
+      stdexec::set_value(std::move(*this).base(), static_cast<As &&>(as)...);
+    }
+  }
+private:
+  Shape shape;
+  F f;
+};
+
+template <stdexec::sender S, typename Shape, typename F>
+struct qthreads_bulk_sender :
+  qthreads_base_sender<qthreads_bulk_sender<S, Shape, F>> {
+  S s;
+  Shape shape;
+  F f;
+
+  // bulk passes the values of the predecessor through unchanged,
+  // so the only thing added here is the error from a throwing invocable.
+  template <class Env>
+  using completions_t = stdexec::transform_completion_signatures_of<
+    S,
+    Env,
+    stdexec::completion_signatures<stdexec::set_error_t(std::exception_ptr)>>;
+
+  template <class Env>
+  auto get_completion_signatures(Env &&) && -> completions_t<Env> {
+    return {};
+  }
+
+  // Same approach as qthreads_then_sender: no additional operation state,
+  // just connect the wrapped sender to the bulk receiver.
+  template <stdexec::receiver R>
+    requires stdexec::sender_to<S, qthreads_bulk_receiver<R, Shape, F>>
+  auto connect(R r) && {
+    return stdexec::connect(
+      std::move(s),
+      qthreads_bulk_receiver<R, Shape, F>{
+        static_cast<R &&>(r), shape, static_cast<F &&>(f)});
+  }
+};
+
+// Our transform_sender override calls into this for implementing stdexec::bulk.
+// Without it bulk falls back to stdexec's default, which runs the whole
+// iteration space serially inside one qthread.
+template <>
+struct transform_sender_for<stdexec::bulk_t> {
+  template <class Data, class Sender>
+    requires is_qthreads_sender<Sender>
+  auto operator()(stdexec::__ignore, Data data, Sender &&sndr) const {
+    // The execution policy is ignored since qt_loop_balance always
+    // spreads the iterations over all shepherds and workers.
+    [[maybe_unused]] auto [policy, shape, fun] = static_cast<Data &&>(data);
+    return qthreads_bulk_sender<Sender, decltype(shape), decltype(fun)>{
+      {}, static_cast<Sender &&>(sndr), shape, std::move(fun)};
+  }
+};
+
+// Helper for constructing immovable operation states in place
+// (e.g. as tuple elements) from the result of stdexec::connect.
+// Same idea as _conv in the retry algorithm.
+template <std::invocable F>
+struct qt_emplace_from {
+  F f;
+
+  operator std::invoke_result_t<F>() && { return static_cast<F &&>(f)(); }
+};
+
+template <std::invocable F>
+qt_emplace_from(F) -> qt_emplace_from<F>;
+
+// Helpers for pulling the single set_value signature of a child sender
+// out as a std::tuple of decayed types.
+template <typename... Ts>
+using qt_decayed_tuple = std::tuple<std::decay_t<Ts>...>;
+
+template <typename... Tuples>
+struct qt_single_value {
+  static_assert(sizeof...(Tuples) == 1,
+                "qthreads when_all requires each child sender to have "
+                "exactly one set_value completion.");
+};
+
+template <typename Tuple>
+struct qt_single_value<Tuple> {
+  using type = Tuple;
+};
+
+template <typename... Tuples>
+using qt_single_value_t = typename qt_single_value<Tuples...>::type;
+
+template <typename S, typename Env>
+using qt_value_tuple_t =
+  stdexec::value_types_of_t<S, Env, qt_decayed_tuple, qt_single_value_t>;
+
+template <typename Tuple>
+struct qt_set_value_sig;
+
+template <typename... Ts>
+struct qt_set_value_sig<std::tuple<Ts...>> {
+  using type = stdexec::set_value_t(Ts...);
+};
+
+// Completion stored by one qthread and replayed to a receiver by
+// another one, e.g. for counting_scope futures or split.
+// Errors are narrowed to the int codes of the qthreads senders or an
+// exception_ptr, same as in when_all.
+struct qt_stopped_result {};
+
+template <typename ValueTuple>
+struct qt_async_result {
+  std::variant<std::monostate,
+               ValueTuple,
+               int,
+               std::exception_ptr,
+               qt_stopped_result>
+    v{};
+
+  template <class... As>
+  void set_value(As &&...as) noexcept {
+    try {
+      v.template emplace<1>(static_cast<As &&>(as)...);
+    } catch (...) {
+      v.template emplace<3>(std::current_exception());
+    }
+  }
+
+  template <class E>
+  void set_error(E &&e) noexcept {
+    if constexpr (std::is_same_v<std::decay_t<E>, int>) {
+      v.template emplace<2>(e);
+    } else if constexpr (std::is_same_v<std::decay_t<E>, std::exception_ptr>) {
+      v.template emplace<3>(static_cast<E &&>(e));
+    } else {
+      v.template emplace<3>(std::make_exception_ptr(static_cast<E &&>(e)));
+    }
+  }
+
+  void set_stopped() noexcept { v.template emplace<4>(); }
+
+  // Completes os with the stored result, moving the values out.
+  template <typename Os>
+  void complete(Os *os) && noexcept {
+    switch (v.index()) {
+      case 1: complete_values(os, std::move(std::get<1>(v))); break;
+      case 2: os->complete_error(std::get<2>(v)); break;
+      case 3: os->complete_error(std::move(std::get<3>(v))); break;
+      default: os->complete_stopped(); break;
+    }
+  }
+
+  // Same, but leaves the stored result alone for other consumers.
+  // A value that fails to copy completes os with the exception.
+  template <typename Os>
+  void complete_copy(Os *os) const noexcept {
+    switch (v.index()) {
+      case 1: {
+        std::optional<ValueTuple> copy;
+        try {
+          copy.emplace(std::get<1>(v));
+        } catch (...) {
+          os->complete_error(std::current_exception());
+          return;
+        }
+        complete_values(os, std::move(*copy));
+        break;
+      }
+      case 2: os->complete_error(std::get<2>(v)); break;
+      case 3: os->complete_error(std::get<3>(v)); break;
+      default: os->complete_stopped(); break;
+    }
+  }
+private:
+  template <typename Os>
+  static void complete_values(Os *os, ValueTuple &&vals) noexcept {
+    std::apply(
+      [os](auto &&...vs) {
+        os->complete_value(static_cast<decltype(vs) &&>(vs)...);
+      },
+      std::move(vals));
+  }
+};
+
+// Env handed to the children of a when_all.
+// The children all share one stop source owned by the operation state
+// so that a failing child can keep the ones that haven't been forked
+// yet from starting.
+struct qthreads_when_all_env {
+  stdexec::inplace_stop_token token;
+
+  friend stdexec::inplace_stop_token
+  tag_invoke(stdexec::get_stop_token_t const,
+             qthreads_when_all_env const &env) noexcept {
+    return env.token;
+  }
+
+  friend qthreads_domain tag_invoke(stdexec::get_domain_t const,
+                                    qthreads_when_all_env const &) noexcept {
+    return {};
+  }
+};
+
+// Receiver connected to the I-th child of a when_all.
+// Each child completes inside its own qthread. The result gets stored
+// in the parent operation state and then the completion is submitted
+// to the parent's sinc.
+template <std::size_t I, typename Parent>
+struct qthreads_when_all_receiver {
+  using receiver_concept = stdexec::receiver_t;
+  Parent *op;
+
+  template <class... As>
+  void set_value(As &&...as) noexcept {
+    op->template set_child_value<I>(static_cast<As &&>(as)...);
+  }
+
+  template <class E>
+  void set_error(E &&e) noexcept {
+    op->set_child_error(static_cast<E &&>(e));
+  }
+
+  void set_stopped() noexcept { op->set_child_stopped(); }
+
+  qthreads_when_all_env get_env() const noexcept {
+    return {op->stop_source.get_token()};
+  }
+};
+
+// Operation state for our customization of stdexec::when_all.
+// The operation itself runs as a qthread.
+// That qthread starts every child, each of which does its own qthread_fork,
+// and then suspends on a single qt_sinc_t until all of them have completed.
+// Waiting on the sinc only parks the ULT, not the worker running it.
+// A stop request on the receiver's token is forwarded to the children
+// for as long as they run.
+template <typename Receiver, typename... Senders>
+struct when_all_operation_state :
+  qt_os_base<when_all_operation_state<Receiver, Senders...>, Receiver> {
+  using base_t =
+    qt_os_base<when_all_operation_state<Receiver, Senders...>, Receiver>;
+
+  // Completion state, the first child to fail wins.
+  enum : int { running = 0, failed_code, failed_exception, stopped };
+
+  template <std::size_t... Is>
+  static auto connect_children(std::index_sequence<Is...>)
+    -> std::tuple<stdexec::connect_result_t<
+      Senders,
+      qthreads_when_all_receiver<Is, when_all_operation_state>>...>;
+
+  using children_t = decltype(connect_children(
+    std::index_sequence_for<Senders...>{}));
+
+  struct forward_stop {
+    stdexec::inplace_stop_source *source;
+
+    void operator()() const noexcept { source->request_stop(); }
+  };
+
+  using parent_stop_callback_t =
+    stdexec::stop_callback_for_t<typename base_t::stop_token_t, forward_stop>;
+
+  qt_sinc_t sinc;
+  std::atomic<int> state{running};
+  int error_code{0};
+  std::exception_ptr error{};
+  stdexec::inplace_stop_source stop_source{};
+  std::optional<parent_stop_callback_t> on_parent_stop{};
+  std::tuple<std::optional<qt_value_tuple_t<Senders, qthreads_when_all_env>>...>
+    values{};
+  children_t children;
+
+  template <typename Receiver_>
+  when_all_operation_state(std::tuple<Senders...> &&sndrs, Receiver_ &&r):
+    when_all_operation_state(std::move(sndrs),
+                             std::forward<Receiver_>(r),
+                             std::index_sequence_for<Senders...>{}) {}
+
+  template <typename Receiver_, std::size_t... Is>
+  when_all_operation_state(std::tuple<Senders...> &&sndrs,
+                           Receiver_ &&r,
+                           std::index_sequence<Is...>):
+    base_t(std::forward<Receiver_>(r)),
+    children(qt_emplace_from{[&] {
+      return stdexec::connect(
+        std::move(std::get<Is>(sndrs)),
+        qthreads_when_all_receiver<Is, when_all_operation_state>{this});
+    }}...) {
+    qt_sinc_init(&sinc, 0, NULL, NULL, sizeof...(Senders));
+  }
+
+  ~when_all_operation_state() { qt_sinc_fini(&sinc); }
+
+  template <std::size_t I, class... As>
+  void set_child_value(As &&...as) noexcept {
+    try {
+      std::get<I>(values).emplace(static_cast<As &&>(as)...);
+    } catch (...) {
+      set_child_error(std::current_exception());
+      return;
+    }
+    qt_sinc_submit(&sinc, NULL);
+  }
+
+  template <class E>
+  void set_child_error(E &&e) noexcept {
+    if constexpr (std::is_same_v<std::decay_t<E>, int>) {
+      if (claim(failed_code)) error_code = e;
+    } else if constexpr (std::is_same_v<std::decay_t<E>, std::exception_ptr>) {
+      if (claim(failed_exception)) error = static_cast<E &&>(e);
+    } else {
+      if (claim(failed_exception)) {
+        error = std::make_exception_ptr(static_cast<E &&>(e));
+      }
+    }
+    qt_sinc_submit(&sinc, NULL);
+  }
+
+  void set_child_stopped() noexcept {
+    claim(stopped);
+    qt_sinc_submit(&sinc, NULL);
+  }
+
+  static aligned_t task(void *os_void) noexcept {
+    auto *os = static_cast<when_all_operation_state *>(os_void);
+    if constexpr (!stdexec::unstoppable_token<typename base_t::stop_token_t>) {
+      os->on_parent_stop.emplace(
+        stdexec::get_stop_token(stdexec::get_env(os->receiver)),
+        forward_stop{&os->stop_source});
+    }
+    std::apply([](auto &...child) { (stdexec::start(child), ...); },
+               os->children);
+    qt_sinc_wait(&os->sinc, NULL);
+    os->on_parent_stop.reset();
+    os->complete();
+    return 0u;
+  }
+private:
+  bool claim(int new_state) noexcept {
+    int expected = running;
+    if (state.compare_exchange_strong(expected, new_state)) {
+      stop_source.request_stop();
+      return true;
+    }
+    return false;
+  }
+
+  void complete() noexcept {
+    switch (state.load()) {
+      case running:
+        std::apply(
+          [this](auto &&...vals) {
+            this->complete_value(static_cast<decltype(vals) &&>(vals)...);
+          },
+          std::apply(
+            [](auto &...opt) { return std::tuple_cat(std::move(*opt)...); },
+            values));
+        break;
+      case failed_code:
+        this->complete_error(error_code);
+        break;
+      case failed_exception:
+        this->complete_error(std::move(error));
+        break;
+      default: this->complete_stopped(); break;
+    }
+  }
+};
+
+// Sender for our customization of stdexec::when_all.
+// The values of all the children are concatenated in order, same as
+// stdexec::when_all.
+template <typename... Senders>
+struct qthreads_when_all_sender :
+  qthreads_base_sender<qthreads_when_all_sender<Senders...>> {
+  std::tuple<Senders...> sndrs;
+
+  using value_t = typename qt_set_value_sig<decltype(std::tuple_cat(
+    std::declval<qt_value_tuple_t<Senders, qthreads_when_all_env>>()...))>::
+    type;
+
+  using completion_signatures =
+    stdexec::completion_signatures<value_t,
+                                   stdexec::set_error_t(int),
+                                   stdexec::set_error_t(std::exception_ptr),
+                                   stdexec::set_stopped_t()>;
+
+  template <stdexec::receiver R>
+  auto connect(R r) && -> when_all_operation_state<R, Senders...> {
+    return {std::move(sndrs), static_cast<R &&>(r)};
+  }
+};
+
+// Our transform_sender override calls into this for implementing
+// stdexec::when_all when every child is a qthreads sender.
+// This replaces stdexec's generic atomic-counter join, which completes
+// from whichever child finishes last instead of from a qthread that can
+// suspend on the join.
+template <>
+struct transform_sender_for<stdexec::when_all_t> {
+  template <class... Senders>
+    requires(is_qthreads_sender<std::remove_cvref_t<Senders>> && ...)
+  auto operator()(stdexec::__ignore,
+                  stdexec::__ignore,
+                  Senders &&...sndrs) const {
+    return qthreads_when_all_sender<std::remove_cvref_t<Senders>...>{
+      {}, {static_cast<Senders &&>(sndrs)...}};
+  }
+};
+
+// Env handed to the receiver used by our sync_wait.
+// Anything that asks the receiver for a scheduler (e.g. read_env or
+// let_value chains) gets work placed back onto qthreads.
+struct qthreads_sync_wait_env {
+  friend qthreads_scheduler tag_invoke(stdexec::get_scheduler_t const,
+                                       qthreads_sync_wait_env const &) noexcept {
+    return {};
+  }
+
+  friend qthreads_domain tag_invoke(stdexec::get_domain_t const,
+                                    qthreads_sync_wait_env const &) noexcept {
+    return {};
+  }
+};
+
+// State shared between sync_wait and its receiver.
+// The FEB lives here rather than in the operation state, so sync_wait
+// doesn't need to know anything about the shape of the operation state
+// it's waiting on. It's emptied before the sender is started and filled
+// by whichever completion channel the receiver sees.
+template <typename Sn>
+struct qthreads_sync_wait_state {
+  aligned_t feb;
+  std::optional<stdexec::__sync_wait::__sync_wait_result_t<Sn>> result{};
+  std::exception_ptr error{};
+
+  qthreads_sync_wait_state() noexcept: feb(0u) { qthread_empty(&feb); }
+
+  void signal() noexcept { qthread_fill(&feb); }
+
+  // Poll the FEB up to spin times before suspending on it.
+  // From inside a qthread, qthread_readFF only parks the calling ULT,
+  // so the worker is free to run other tasks in the meantime.
+  void wait(std::size_t spin) noexcept {
+    for (std::size_t i = 0; i < spin; ++i) {
+      if (qthread_feb_status(&feb)) return;
+    }
+    qthread_readFF(NULL, &feb);
+  }
+};
+
+template <typename Sn>
+struct qthreads_sync_wait_receiver {
+  using receiver_concept = stdexec::receiver_t;
+  qthreads_sync_wait_state<Sn> *state;
+
+  template <class... As>
+  void set_value(As &&...as) noexcept {
+    try {
+      state->result.emplace(static_cast<As &&>(as)...);
+    } catch (...) {
+      state->error = std::current_exception();
+    }
+    state->signal();
+  }
+
+  // Errors are rethrown from sync_wait the same way stdexec::sync_wait
+  // does it.
+  template <class E>
+  void set_error(E &&e) noexcept {
+    if constexpr (std::is_same_v<std::decay_t<E>, std::exception_ptr>) {
+      state->error = static_cast<E &&>(e);
+    } else if constexpr (std::is_same_v<std::decay_t<E>, std::error_code>) {
+      state->error = std::make_exception_ptr(std::system_error(e));
+    } else {
+      state->error = std::make_exception_ptr(static_cast<E &&>(e));
+    }
+    state->signal();
+  }
+
+  void set_stopped() noexcept { state->signal(); }
+
+  qthreads_sync_wait_env get_env() const noexcept { return {}; }
+};
+
 template <>
 struct apply_sender_for<stdexec::sync_wait_t> {
-  template <typename S>
-  auto operator()(S &&sn);
+  // Number of times to poll for completion before blocking.
+  // Zero means block on the FEB right away.
+  std::size_t spin = 0;
 
   // Our customization of stdexec::sync_wait calls into this.
-  // This is where most of the work for that happens.
-  template <typename Sn>
-    requires is_qthreads_sender<Sn>
-  auto operator()(Sn &&sn) {
-    // We're relying on some internal stuff from stdexec::sync_wait here.
-    stdexec::__sync_wait::__state local_state{};
-    std::optional<stdexec::__sync_wait::__sync_wait_result_t<Sn>> result{};
+  // This works for any sender in the qthreads domain, not just
+  // the ones whose outermost operation state is a qt_os_base.
+  template <stdexec::sender Sn>
+  auto operator()(Sn &&sn) const {
+    qthreads_sync_wait_state<Sn> state{};
 
-    // Launch the sender with a continuation that will fill in the __result
-    // optional or set the exception_ptr in __local_state.
     [[maybe_unused]]
-    auto op = stdexec::connect(
-      std::move(sn),
-      stdexec::__sync_wait::__receiver_t<Sn>{&local_state, &result});
+    auto op = stdexec::connect(static_cast<Sn &&>(sn),
+                               qthreads_sync_wait_receiver<Sn>{&state});
     stdexec::start(op);
 
-    // Wait on the FEB associated with the qthread.
-    // TODO: make a function call to get its address out of the
-    // operation state instead of accessing it directly.
-    // Currently this works for our override of stdexec::then,
-    // but there may be other stuff that requires the extra indirection.
-    qthread_readFF(NULL, &op.feb);
-    return result;
+    state.wait(spin);
+    if (state.error) std::rethrow_exception(std::move(state.error));
+    return std::move(state.result);
   }
 };
 
+// Hybrid spin-then-block version of sync_wait.
+// Useful when the sender is expected to finish within a few microseconds
+// and the cost of suspending/waking on the FEB would dominate.
+template <stdexec::sender Sn>
+auto sync_wait(Sn &&sn, std::size_t spin) {
+  return apply_sender_for<stdexec::sync_wait_t>{spin}(static_cast<Sn &&>(sn));
+}
+
 // Base case for transform_sender.
 template <typename Sn, typename... Env>
   requires is_qthreads_sender<Sn>
@@ -1,9 +1,9 @@
-#define once
+#pragma once
 
-#include <iostream>
-#include <memory>
 #include <stdexec/execution.hpp>
 #include <stdio.h>
+#include <type_traits>
+#include <utility>
 
 #include <qthread/qloop.h>
 #include <qthread/qthread.h>
@@ -12,77 +12,157 @@ namespace stdexx {
 
 namespace ex = stdexec;
 
-int context_init() { return qthread_initialize(); }
-
-void context_finalize() { qthread_finalize(); }
+// Handle to the qthreads runtime used by the v2 algorithms.
+// It doesn't start or stop anything itself, the runtime is owned by a
+// stdexx::runtime that has to outlive every sender built from this.
+struct qthreads_context {};
+
+// Work senders may hand back the FEB of the qthread they forked
+// instead of a value. Those get waited on and replaced by the
+// value the qthread returned. Everything else is passed through as is.
+template <class T>
+using on_qthreads_result_t =
+  std::conditional_t<std::is_same_v<std::decay_t<T>, aligned_t *>,
+                     aligned_t,
+                     T>;
+
+inline aligned_t on_qthreads_unwrap(aligned_t *feb) noexcept {
+  aligned_t ret;
+  qthread_readFF(&ret, feb);
+  return ret;
+}
 
-struct qthreads_context {
-  struct qthreads {};
+template <class T>
+T &&on_qthreads_unwrap(T &&t) noexcept {
+  return static_cast<T &&>(t);
+}
 
-  std::shared_ptr<qthreads> ctx = std::make_shared<qthreads>();
+// Receiver for the work sender. Completes the downstream receiver,
+// which lives in the outer operation state.
+template <ex::receiver Receiver>
+struct on_qthreads_work_receiver {
+  using receiver_concept = ex::receiver_t;
+  Receiver *receiver_;
 
-  qthreads_context() { context_init(); }
+  template <class... As>
+  void set_value(As &&...as) noexcept {
+    ex::set_value(std::move(*receiver_),
+                  on_qthreads_unwrap(static_cast<As &&>(as))...);
+  }
 
-  ~qthreads_context() {
-    if (ctx.use_count() == 1) context_finalize();
+  template <class E>
+  void set_error(E &&e) noexcept {
+    ex::set_error(std::move(*receiver_), static_cast<E &&>(e));
   }
 
-  qthreads_context(qthreads_context const &other): ctx(other.ctx) {}
+  void set_stopped() noexcept { ex::set_stopped(std::move(*receiver_)); }
 
-  qthreads_context &operator=(qthreads_context const &&other) { return *this; }
+  ex::env_of_t<Receiver> get_env() const noexcept {
+    return ex::get_env(*receiver_);
+  }
 };
 
-template <ex::receiver Receiver, ex::sender Work>
+// Receiver for the previous sender. The values it sends are dropped,
+// its completion only means the work can be started now.
+// The work operation state was already connected up front, so there
+// is nothing to allocate or connect here.
+template <ex::receiver Receiver, class WorkOp>
 struct on_qthreads_receiver {
-  qthreads_context ctx_;
-  Work work_;
-  Receiver receiver_;
   using receiver_concept = ex::receiver_t;
+  Receiver *receiver_;
+  WorkOp *work_op_;
 
-  void set_value(int i) noexcept {
-    std::cout << "work_and_done" << std::endl;
-    ex::sender auto and_done = ex::then(work_, [](aligned_t *feb) {
-      qthread_readFF(NULL, feb);
-      std::cout << "FEB:" << feb << std::endl;
-    });
+  template <class... As>
+  void set_value(As &&...) noexcept {
+    ex::start(*work_op_);
+  }
 
-    auto op = ex::connect(and_done, std::move(receiver_));
-    ex::start(op);
+  template <class E>
+  void set_error(E &&e) noexcept {
+    ex::set_error(std::move(*receiver_), static_cast<E &&>(e));
   }
 
-  void set_error(std::exception_ptr e) noexcept {
-    ex::set_error(std::move(receiver_), e);
+  void set_stopped() noexcept { ex::set_stopped(std::move(*receiver_)); }
+
+  ex::env_of_t<Receiver> get_env() const noexcept {
+    return ex::get_env(*receiver_);
   }
+};
 
-  void set_stopped() noexcept { ex::set_stopped(std::move(receiver_)); }
+// Outer operation state. Owns the downstream receiver and both nested
+// operation states, so nothing outlives it and nothing is built on
+// the completion path. It can't be moved since the nested receivers
+// point back into it.
+template <ex::sender Previous, ex::sender Work, ex::receiver Receiver>
+struct on_qthreads_operation_state {
+  using work_receiver_t = on_qthreads_work_receiver<Receiver>;
+  using work_op_t = ex::connect_result_t<Work, work_receiver_t>;
+  using previous_receiver_t = on_qthreads_receiver<Receiver, work_op_t>;
+  using previous_op_t = ex::connect_result_t<Previous, previous_receiver_t>;
+
+  Receiver receiver_;
+  work_op_t work_op_;
+  previous_op_t previous_op_;
+
+  on_qthreads_operation_state(Previous &&prev, Work &&work, Receiver &&r):
+    receiver_(std::move(r)),
+    work_op_(ex::connect(std::move(work), work_receiver_t{&receiver_})),
+    previous_op_(ex::connect(std::move(prev),
+                             previous_receiver_t{&receiver_, &work_op_})) {}
+
+  on_qthreads_operation_state(on_qthreads_operation_state &&) = delete;
+
+  void start() & noexcept { ex::start(previous_op_); }
 };
 
+template <class...>
+using on_qthreads_no_value_t = ex::completion_signatures<>;
+
+template <class... As>
+using on_qthreads_value_t =
+  ex::completion_signatures<ex::set_value_t(on_qthreads_result_t<As>...)>;
+
 template <ex::sender Previous, ex::sender Work>
 struct on_qthreads_sender {
-  qthreads_context ctx_;
+  // Not owned, the context has to outlive the sender and its operation.
+  qthreads_context *ctx_;
   Previous previous_;
   Work work_;
   using sender_concept = ex::sender_t;
-  using completion_signatures =
-    ex::completion_signatures<ex::set_value_t(int t),
-                              ex::set_error_t(std::exception_ptr),
-                              ex::set_stopped_t()>;
+
+  // The work's completions, plus the errors and stopped of the previous
+  // sender, whose values are dropped.
+  template <class Env>
+  using completions_t = ex::transform_completion_signatures_of<
+    Work,
+    Env,
+    ex::transform_completion_signatures_of<Previous,
+                                           Env,
+                                           ex::completion_signatures<>,
+                                           on_qthreads_no_value_t>,
+    on_qthreads_value_t>;
+
+  template <class Env>
+  auto get_completion_signatures(Env &&) && -> completions_t<Env> {
+    return {};
+  }
 
   ex::env<> get_env() const noexcept { return {}; }
 
   template <ex::receiver Receiver>
-  auto connect(Receiver receiver) noexcept {
-    return ex::connect(previous_, on_qthreads_receiver{ctx_, work_, receiver});
+  auto connect(Receiver receiver) &&
+    -> on_qthreads_operation_state<Previous, Work, Receiver> {
+    return {std::move(previous_), std::move(work_), std::move(receiver)};
   }
 };
 
 // This is motivated by the stdexec::then algorithm but takes a ctx and two
-// senders instead
+// senders instead. Once prev completes, work is started and its result
+// is what the returned sender completes with.
 template <ex::sender Previous, ex::sender Work>
 auto then(Previous prev, qthreads_context &ctx, Work work)
   -> on_qthreads_sender<Previous, Work> {
-  return {ctx, prev, work};
+  return {&ctx, std::move(prev), std::move(work)};
 }
 
 } // namespace stdexx
-
@@ -0,0 +1,437 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <thread>
+
+#include <qthreads/stdexec.hpp>
+
+namespace stdexx {
+
+class qthreads_timer;
+struct qthreads_timed_scheduler;
+struct qthreads_timer_sender;
+
+// Intrusive entry for one pending timer, embedded in its operation
+// state. pprev points at whatever points at this node (the slot head or
+// the previous node's next), so unlinking doesn't need to know the slot.
+struct qt_timer_node {
+  enum : int { pending = 0, fired, cancelled };
+
+  qt_timer_node *next{nullptr};
+  qt_timer_node **pprev{nullptr};
+  std::uint64_t tick{0};
+  std::atomic<int> state{pending};
+  void *owner{nullptr};
+  void (*fire)(qt_timer_node *) noexcept {nullptr};
+
+  bool linked() const noexcept { return pprev != nullptr; }
+};
+
+// Source of deadlines for qthreads work.
+// Pending timers live in a hierarchical timer wheel: 4 levels of 256
+// slots, each level covering 256 times the span of the one below, so
+// inserting and cancelling are O(1) and far-off timers only get
+// cascaded down a level at a time as they come close.
+// A single timekeeper thread sleeps until the next slot with timers in
+// it is due, and forks the due continuations as qthreads. Nothing that
+// waits for a deadline ever occupies a qthreads worker.
+// The timekeeper is a plain OS thread rather than a qthread, since it
+// spends nearly all of its time asleep.
+// Every operation started on it has to be done before it's destroyed.
+class qthreads_timer {
+public:
+  using clock = std::chrono::steady_clock;
+
+  explicit qthreads_timer(
+    clock::duration resolution = std::chrono::microseconds(100)):
+    resolution_(resolution), epoch_(clock::now()),
+    keeper_([this] { run(); }) {}
+
+  qthreads_timer(qthreads_timer const &) = delete;
+  qthreads_timer &operator=(qthreads_timer const &) = delete;
+
+  ~qthreads_timer() {
+    {
+      std::lock_guard lock(mutex_);
+      stopping_ = true;
+    }
+    wake_.notify_one();
+    keeper_.join();
+  }
+
+  qthreads_timed_scheduler get_scheduler() noexcept;
+
+  clock::time_point now() const noexcept { return clock::now(); }
+
+  // Links the node into the wheel unless it's already due or was
+  // cancelled in the meantime. Returns whether it was linked, if not
+  // the caller fires it.
+  bool insert(qt_timer_node *node, clock::time_point deadline) noexcept {
+    node->tick = to_tick(deadline);
+    bool earlier;
+    {
+      std::lock_guard lock(mutex_);
+      if (node->state.load() != qt_timer_node::pending) return true;
+      // The keeper only moves current_ along while it has timers, so
+      // after an idle spell it's stale. Catch it up here, same as the
+      // keeper does, or it'd walk the whole gap one tick at a time.
+      if (count_ == 0) current_ = std::max(current_, to_tick(clock::now()));
+      if (node->tick <= current_) return false;
+      earlier = count_ == 0 || node->tick < wake_tick_;
+      place(node);
+    }
+    if (earlier) wake_.notify_one();
+    return true;
+  }
+
+  void remove(qt_timer_node *node) noexcept {
+    std::lock_guard lock(mutex_);
+    if (node->linked()) unlink(node);
+  }
+private:
+  static constexpr int slot_bits = 8;
+  static constexpr std::uint64_t num_slots = 1u << slot_bits;
+  static constexpr std::uint64_t slot_mask = num_slots - 1;
+  static constexpr int num_levels = 4;
+  using level_t = std::array<qt_timer_node *, num_slots>;
+
+  // Rounds up, so a timer never fires before its deadline.
+  std::uint64_t to_tick(clock::time_point t) const noexcept {
+    if (t <= epoch_) return 0;
+    auto d = t - epoch_;
+    return static_cast<std::uint64_t>((d + resolution_ - clock::duration(1)) /
+                                      resolution_);
+  }
+
+  clock::time_point to_time(std::uint64_t tick) const noexcept {
+    return epoch_ + resolution_ * static_cast<clock::rep>(tick);
+  }
+
+  static void link(qt_timer_node *&head, qt_timer_node *node) noexcept {
+    node->next = head;
+    if (head) head->pprev = &node->next;
+    head = node;
+    node->pprev = &head;
+  }
+
+  void unlink(qt_timer_node *node) noexcept {
+    *node->pprev = node->next;
+    if (node->next) node->next->pprev = node->pprev;
+    node->next = nullptr;
+    node->pprev = nullptr;
+    --count_;
+  }
+
+  // Puts the node in the lowest level whose span covers its deadline.
+  // Deadlines past the top level are parked at its far end and placed
+  // again when they get cascaded.
+  void place(qt_timer_node *node) noexcept {
+    std::uint64_t delta = node->tick - current_;
+    int level = 0;
+    while (level < num_levels - 1 &&
+           delta >= (std::uint64_t(1) << (slot_bits * (level + 1)))) {
+      ++level;
+    }
+    std::uint64_t tick = node->tick;
+    std::uint64_t span = std::uint64_t(1) << (slot_bits * num_levels);
+    if (delta >= span) tick = current_ + span - 1;
+    link(levels_[level][(tick >> (slot_bits * level)) & slot_mask], node);
+    ++count_;
+  }
+
+  // Moves every node of a higher level slot down to where it belongs
+  // now, or onto the due list if its time has come.
+  void cascade(int level, qt_timer_node *&due) noexcept {
+    auto &slot = levels_[level][(current_ >> (slot_bits * level)) & slot_mask];
+    while (qt_timer_node *node = slot) {
+      unlink(node);
+      if (node->tick <= current_) {
+        collect(node, due);
+      } else {
+        place(node);
+      }
+    }
+  }
+
+  static void collect(qt_timer_node *node, qt_timer_node *&due) noexcept {
+    int expected = qt_timer_node::pending;
+    if (node->state.compare_exchange_strong(expected, qt_timer_node::fired)) {
+      node->next = due;
+      due = node;
+    }
+  }
+
+  // Advances the wheel one tick and collects everything due on it.
+  void advance(qt_timer_node *&due) noexcept {
+    ++current_;
+    for (int level = 1; level < num_levels; ++level) {
+      if ((current_ >> (slot_bits * (level - 1))) & slot_mask) break;
+      cascade(level, due);
+    }
+    auto &slot = levels_[0][current_ & slot_mask];
+    while (qt_timer_node *node = slot) {
+      unlink(node);
+      collect(node, due);
+    }
+  }
+
+  // Next tick worth waking up for: the next non-empty slot of the
+  // lowest level, or the next cascade if that's empty up to it.
+  std::uint64_t next_wake() const noexcept {
+    std::uint64_t end = (current_ | slot_mask) + 1;
+    for (std::uint64_t t = current_ + 1; t < end; ++t) {
+      if (levels_[0][t & slot_mask]) return t;
+    }
+    return end;
+  }
+
+  void run() {
+    std::unique_lock lock(mutex_);
+    while (!stopping_) {
+      qt_timer_node *due = nullptr;
+      std::uint64_t now_tick = to_tick(clock::now());
+      while (count_ && current_ < now_tick) advance(due);
+      if (!count_) current_ = std::max(current_, now_tick);
+
+      if (due) {
+        lock.unlock();
+        while (due) {
+          qt_timer_node *node = due;
+          due = node->next;
+          node->next = nullptr;
+          node->fire(node);
+        }
+        lock.lock();
+        continue;
+      }
+
+      if (count_) {
+        wake_tick_ = next_wake();
+        wake_.wait_until(lock, to_time(wake_tick_));
+      } else {
+        wake_.wait(lock);
+      }
+    }
+  }
+
+  clock::duration resolution_;
+  clock::time_point epoch_;
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  bool stopping_{false};
+  std::uint64_t current_{0};
+  std::uint64_t wake_tick_{0};
+  std::size_t count_{0};
+  std::array<level_t, num_levels> levels_{};
+  std::thread keeper_;
+};
+
+// Operation state for schedule_at/schedule_after.
+// The node is linked into the timer wheel on start. When it comes due,
+// the timekeeper runs the regular qt_os_base start, which forks the
+// continuation as a qthread. While it's pending, a stop request unlinks
+// it and completes with set_stopped from a qthread of its own.
+// Firing or cancelling can happen while start() is still registering the
+// stop callback and linking the node, even from inside the registration.
+// So start() and whichever of fire/cancel won the node race hand off
+// through phase: the second one to get there completes the operation.
+template <typename Receiver>
+struct timer_operation_state :
+  qt_os_base<timer_operation_state<Receiver>, Receiver> {
+  using base_t = qt_os_base<timer_operation_state<Receiver>, Receiver>;
+
+  struct cancel_timer {
+    timer_operation_state *os;
+
+    void operator()() const noexcept { os->cancel(); }
+  };
+
+  using pending_callback_t =
+    stdexec::stop_callback_for_t<typename base_t::stop_token_t, cancel_timer>;
+
+  // starting: start() isn't done yet.
+  // armed: start() is done, fire/cancel completes.
+  // fired, cancelled: happened during start(), start() completes.
+  enum : int { starting = 0, armed, fired, cancelled };
+
+  qthreads_timer *timer;
+  qthreads_timer::clock::time_point deadline;
+  qt_timer_node node{};
+  std::optional<pending_callback_t> on_pending_stop{};
+  std::atomic<int> phase{starting};
+
+  template <typename Receiver_>
+  timer_operation_state(qthreads_timer *timer_,
+                        qthreads_timer::clock::time_point deadline_,
+                        Receiver_ &&receiver):
+    base_t(std::forward<Receiver_>(receiver)), timer(timer_),
+    deadline(deadline_) {
+    node.owner = this;
+    node.fire = &timer_operation_state::fire;
+  }
+
+  void start() & noexcept {
+    auto st = stdexec::get_stop_token(stdexec::get_env(this->receiver));
+    if (st.stop_requested()) {
+      stdexec::set_stopped(std::move(this->receiver));
+      return;
+    }
+    // The callback goes in before the node is linked, so the timekeeper
+    // never sees a node whose callback is still being registered.
+    if constexpr (!stdexec::unstoppable_token<typename base_t::stop_token_t>) {
+      on_pending_stop.emplace(st, cancel_timer{this});
+    }
+    if (!timer->insert(&node, deadline)) {
+      // Already due, skip the wheel.
+      int expected = qt_timer_node::pending;
+      if (node.state.compare_exchange_strong(expected, qt_timer_node::fired)) {
+        finish(fired);
+        return;
+      }
+    }
+    int expected = starting;
+    if (!phase.compare_exchange_strong(expected,
+                                       armed,
+                                       std::memory_order_acq_rel)) {
+      finish(expected);
+    }
+  }
+
+  static aligned_t task(void *os_void) noexcept {
+    auto *os = static_cast<timer_operation_state *>(os_void);
+    os->complete_value();
+    return 0u;
+  }
+private:
+  // Called by the winner of the node race. Returns whether start() is
+  // done, in which case the caller has to complete the operation.
+  bool resolve(int how) noexcept {
+    int expected = starting;
+    return !phase.compare_exchange_strong(expected,
+                                          how,
+                                          std::memory_order_acq_rel);
+  }
+
+  // Completes the operation, exactly once. on_pending_stop is gone
+  // before the receiver is touched, and resetting it waits for a stop
+  // callback that's still running on another thread.
+  void finish(int how) noexcept {
+    on_pending_stop.reset();
+    if (how == fired) {
+      base_t::start();
+    } else {
+      this->complete_stopped();
+    }
+  }
+
+  static void fire(qt_timer_node *n) noexcept {
+    auto *os = static_cast<timer_operation_state *>(n->owner);
+    if (os->resolve(fired)) os->finish(fired);
+  }
+
+  void cancel() noexcept {
+    int expected = qt_timer_node::pending;
+    if (!node.state.compare_exchange_strong(expected,
+                                            qt_timer_node::cancelled)) {
+      return;
+    }
+    // Unlinked before resolving, once start() completes the operation
+    // may be gone.
+    timer->remove(&node);
+    if (!resolve(cancelled)) return;
+    int r = qthread_fork(&timer_operation_state::cancel_task, this, NULL);
+    if (r != QTHREAD_SUCCESS) {
+      // Can't leave the operation hanging, so complete from here. A stop
+      // callback may deregister itself from inside the call.
+      finish(cancelled);
+    }
+  }
+
+  static aligned_t cancel_task(void *os_void) noexcept {
+    auto *os = static_cast<timer_operation_state *>(os_void);
+    os->finish(cancelled);
+    return 0u;
+  }
+};
+
+// Sender returned by schedule_at/schedule_after on a timed scheduler.
+struct qthreads_timer_sender : qthreads_base_sender<qthreads_timer_sender> {
+  qthreads_timer *timer;
+  qthreads_timer::clock::time_point deadline;
+
+  using completion_signatures =
+    stdexec::completion_signatures<stdexec::set_value_t(),
+                                   stdexec::set_stopped_t(),
+                                   stdexec::set_error_t(int)>;
+
+  template <typename Receiver>
+  timer_operation_state<std::remove_cvref_t<Receiver>>
+  connect(Receiver &&receiver) && {
+    return {timer, deadline, std::forward<Receiver>(receiver)};
+  }
+};
+
+// qthreads_scheduler plus deadlines. schedule() is the same as for
+// qthreads_scheduler, schedule_at/schedule_after complete on a fresh
+// qthread once the deadline has passed, e.g. for retries with backoff
+// instead of sleep_for inside a task.
+struct qthreads_timed_scheduler {
+  using clock = qthreads_timer::clock;
+
+  qthreads_timer *timer;
+
+  friend qthreads_domain tag_invoke(stdexec::get_domain_t const,
+                                    qthreads_timed_scheduler const &) noexcept {
+    return {};
+  }
+
+  bool operator==(qthreads_timed_scheduler const &rhs) const noexcept {
+    return timer == rhs.timer;
+  }
+
+  bool operator!=(qthreads_timed_scheduler const &rhs) const noexcept {
+    return !(*this == rhs);
+  }
+
+  qthreads_sender schedule() const noexcept { return {}; }
+
+  clock::time_point now() const noexcept { return clock::now(); }
+
+  qthreads_timer_sender schedule_at(clock::time_point deadline) const noexcept {
+    return {{}, timer, deadline};
+  }
+
+  template <class Rep, class Period>
+  qthreads_timer_sender
+  schedule_after(std::chrono::duration<Rep, Period> delay) const noexcept {
+    return schedule_at(
+      clock::now() + std::chrono::duration_cast<clock::duration>(delay));
+  }
+};
+
+inline qthreads_timed_scheduler qthreads_timer::get_scheduler() noexcept {
+  return {this};
+}
+
+inline qthreads_timer_sender
+schedule_at(qthreads_timed_scheduler const &sched,
+            qthreads_timed_scheduler::clock::time_point deadline) noexcept {
+  return sched.schedule_at(deadline);
+}
+
+template <class Rep, class Period>
+qthreads_timer_sender
+schedule_after(qthreads_timed_scheduler const &sched,
+               std::chrono::duration<Rep, Period> delay) noexcept {
+  return sched.schedule_after(delay);
+}
+
+} // namespace stdexx
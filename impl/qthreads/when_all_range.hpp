@@ -0,0 +1,281 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <ranges>
+#include <vector>
+
+#include <qthreads/stdexec.hpp>
+
+namespace stdexx {
+
+// Element type of the vector sent by when_all_range.
+// Children that send a single value are collected as that value,
+// children that send several as a tuple of them. Children that send
+// nothing make when_all_range send nothing too.
+template <typename Tuple>
+struct qt_range_element {
+  using type = Tuple;
+};
+
+template <typename T>
+struct qt_range_element<std::tuple<T>> {
+  using type = T;
+};
+
+template <>
+struct qt_range_element<std::tuple<>> {
+  using type = void;
+};
+
+template <typename S>
+using qt_range_element_t = typename qt_range_element<
+  qt_value_tuple_t<S, qthreads_when_all_env>>::type;
+
+// Receiver connected to the i-th child of a when_all_range.
+// The index is only known at runtime, so unlike the when_all receiver
+// it's carried as a member.
+template <typename Parent>
+struct qthreads_when_all_range_receiver {
+  using receiver_concept = stdexec::receiver_t;
+  Parent *op;
+  std::size_t index;
+
+  template <class... As>
+  void set_value(As &&...as) noexcept {
+    op->set_child_value(index, static_cast<As &&>(as)...);
+  }
+
+  template <class E>
+  void set_error(E &&e) noexcept {
+    op->set_child_error(static_cast<E &&>(e));
+  }
+
+  void set_stopped() noexcept { op->set_child_stopped(); }
+
+  qthreads_when_all_env get_env() const noexcept {
+    return {op->stop_source.get_token()};
+  }
+};
+
+// Operation state for stdexx::when_all_range.
+// Same scheme as when_all_operation_state: the operation runs as a
+// qthread that starts every child and suspends on one qt_sinc_t sized
+// for all of them. The child operation states are all placed in a
+// single allocation made at connect time and the results go in a
+// vector of the same size, so nothing is allocated per child.
+template <typename Receiver, typename Sender>
+struct when_all_range_operation_state :
+  qt_os_base<when_all_range_operation_state<Receiver, Sender>, Receiver> {
+  using base_t =
+    qt_os_base<when_all_range_operation_state<Receiver, Sender>, Receiver>;
+  using receiver_t = qthreads_when_all_range_receiver<
+    when_all_range_operation_state>;
+  using child_op_t = stdexec::connect_result_t<Sender, receiver_t>;
+  using element_t = qt_range_element_t<Sender>;
+  static constexpr bool sends_values = !std::is_void_v<element_t>;
+  // Placeholder so the results vector can be declared for void children.
+  using slot_t = std::conditional_t<sends_values,
+                                    std::optional<element_t>,
+                                    std::tuple<>>;
+
+  // Completion state, the first child to fail wins.
+  enum : int { running = 0, failed_code, failed_exception, stopped };
+
+  struct forward_stop {
+    stdexec::inplace_stop_source *source;
+
+    void operator()() const noexcept { source->request_stop(); }
+  };
+
+  using parent_stop_callback_t =
+    stdexec::stop_callback_for_t<typename base_t::stop_token_t, forward_stop>;
+
+  qt_sinc_t sinc;
+  std::atomic<int> state{running};
+  int error_code{0};
+  std::exception_ptr error{};
+  stdexec::inplace_stop_source stop_source{};
+  std::optional<parent_stop_callback_t> on_parent_stop{};
+  std::size_t num_children;
+  std::vector<slot_t> values;
+  std::allocator<child_op_t> alloc{};
+  child_op_t *children;
+
+  template <typename Receiver_>
+  when_all_range_operation_state(std::vector<Sender> &&sndrs, Receiver_ &&r):
+    base_t(std::forward<Receiver_>(r)), num_children(sndrs.size()),
+    values(sends_values ? num_children : 0),
+    children(num_children ? alloc.allocate(num_children) : nullptr) {
+    std::size_t i = 0;
+    try {
+      for (; i < num_children; ++i) {
+        ::new (static_cast<void *>(children + i))
+          child_op_t(qt_emplace_from{[&] {
+            return stdexec::connect(std::move(sndrs[i]), receiver_t{this, i});
+          }});
+      }
+    } catch (...) {
+      destroy_children(i);
+      throw;
+    }
+    qt_sinc_init(&sinc, 0, NULL, NULL, num_children);
+  }
+
+  ~when_all_range_operation_state() {
+    qt_sinc_fini(&sinc);
+    destroy_children(num_children);
+  }
+
+  template <class... As>
+  void set_child_value(std::size_t i, As &&...as) noexcept {
+    if constexpr (sends_values) {
+      try {
+        values[i].emplace(static_cast<As &&>(as)...);
+      } catch (...) {
+        set_child_error(std::current_exception());
+        return;
+      }
+    }
+    qt_sinc_submit(&sinc, NULL);
+  }
+
+  template <class E>
+  void set_child_error(E &&e) noexcept {
+    if constexpr (std::is_same_v<std::decay_t<E>, int>) {
+      if (claim(failed_code)) error_code = e;
+    } else if constexpr (std::is_same_v<std::decay_t<E>, std::exception_ptr>) {
+      if (claim(failed_exception)) error = static_cast<E &&>(e);
+    } else {
+      if (claim(failed_exception)) {
+        error = std::make_exception_ptr(static_cast<E &&>(e));
+      }
+    }
+    qt_sinc_submit(&sinc, NULL);
+  }
+
+  void set_child_stopped() noexcept {
+    claim(stopped);
+    qt_sinc_submit(&sinc, NULL);
+  }
+
+  static aligned_t task(void *os_void) noexcept {
+    auto *os = static_cast<when_all_range_operation_state *>(os_void);
+    if constexpr (!stdexec::unstoppable_token<typename base_t::stop_token_t>) {
+      os->on_parent_stop.emplace(
+        stdexec::get_stop_token(stdexec::get_env(os->receiver)),
+        forward_stop{&os->stop_source});
+    }
+    for (std::size_t i = 0; i < os->num_children; ++i) {
+      stdexec::start(os->children[i]);
+    }
+    if (os->num_children) qt_sinc_wait(&os->sinc, NULL);
+    os->on_parent_stop.reset();
+    os->complete();
+    return 0u;
+  }
+private:
+  bool claim(int new_state) noexcept {
+    int expected = running;
+    if (state.compare_exchange_strong(expected, new_state)) {
+      stop_source.request_stop();
+      return true;
+    }
+    return false;
+  }
+
+  void destroy_children(std::size_t n) noexcept {
+    if (!children) return;
+    for (std::size_t i = 0; i < n; ++i) children[i].~child_op_t();
+    alloc.deallocate(children, num_children);
+    children = nullptr;
+  }
+
+  void complete() noexcept {
+    switch (state.load()) {
+      case running:
+        if constexpr (sends_values) {
+          std::vector<element_t> result;
+          try {
+            result.reserve(num_children);
+            for (auto &v : values) result.push_back(std::move(*v));
+          } catch (...) {
+            this->complete_error(std::current_exception());
+            return;
+          }
+          this->complete_value(std::move(result));
+        } else {
+          this->complete_value();
+        }
+        break;
+      case failed_code:
+        this->complete_error(error_code);
+        break;
+      case failed_exception:
+        this->complete_error(std::move(error));
+        break;
+      default: this->complete_stopped(); break;
+    }
+  }
+};
+
+template <typename Element>
+struct qt_range_value_sig {
+  using type = stdexec::set_value_t(std::vector<Element>);
+};
+
+template <>
+struct qt_range_value_sig<void> {
+  using type = stdexec::set_value_t();
+};
+
+template <typename Sender>
+struct qthreads_when_all_range_sender :
+  qthreads_base_sender<qthreads_when_all_range_sender<Sender>> {
+  std::vector<Sender> sndrs;
+
+  using completion_signatures = stdexec::completion_signatures<
+    typename qt_range_value_sig<qt_range_element_t<Sender>>::type,
+    stdexec::set_error_t(int),
+    stdexec::set_error_t(std::exception_ptr),
+    stdexec::set_stopped_t()>;
+
+  template <stdexec::receiver R>
+  auto connect(R r) && -> when_all_range_operation_state<R, Sender> {
+    return {std::move(sndrs), static_cast<R &&>(r)};
+  }
+};
+
+// Joins a runtime-sized range of senders of the same type.
+// Sends a std::vector with the value of each child in range order,
+// or nothing if the children send nothing. Like when_all, the first
+// error or stop wins and stop is requested on the other children.
+// An rvalue vector of senders is taken over as is. Otherwise the
+// senders are copied out of lvalue ranges and moved out of rvalue ones.
+template <std::ranges::input_range Range>
+  requires stdexec::sender<std::ranges::range_value_t<Range>>
+auto when_all_range(Range &&sndrs)
+  -> qthreads_when_all_range_sender<std::ranges::range_value_t<Range>> {
+  using sender_t = std::ranges::range_value_t<Range>;
+  if constexpr (std::is_same_v<std::remove_cvref_t<Range>,
+                               std::vector<sender_t>> &&
+                !std::is_lvalue_reference_v<Range>) {
+    return {{}, std::move(sndrs)};
+  } else {
+    std::vector<sender_t> v;
+    if constexpr (std::ranges::sized_range<Range>) {
+      v.reserve(std::ranges::size(sndrs));
+    }
+    for (auto &&s : sndrs) {
+      if constexpr (std::is_lvalue_reference_v<Range>) {
+        v.push_back(s);
+      } else {
+        v.push_back(std::move(s));
+      }
+    }
+    return {{}, std::move(v)};
+  }
+}
+
+} // namespace stdexx
@@ -0,0 +1,201 @@
+#pragma once
+
+#include <qthreads/stdexec.hpp>
+
+namespace stdexx {
+
+// Receiver connected to every child of a when_any.
+// Unlike when_all the children all share one receiver type,
+// since the result slot doesn't depend on which child produced it.
+template <typename Parent>
+struct qthreads_when_any_receiver {
+  using receiver_concept = stdexec::receiver_t;
+  Parent *op;
+
+  template <class... As>
+  void set_value(As &&...as) noexcept {
+    op->set_child_value(static_cast<As &&>(as)...);
+  }
+
+  template <class E>
+  void set_error(E &&e) noexcept {
+    op->set_child_error(static_cast<E &&>(e));
+  }
+
+  void set_stopped() noexcept { op->set_child_stopped(); }
+
+  // Same env as the children of when_all: a stop token tied
+  // to the stop source of the parent operation state.
+  qthreads_when_all_env get_env() const noexcept {
+    return {op->stop_source.get_token()};
+  }
+};
+
+// Operation state for stdexx::when_any.
+// Structured like when_all_operation_state: the operation runs as a
+// qthread that starts all children and suspends on a single qt_sinc_t.
+// The first child to produce a value wins and requests stop on the rest.
+// Children that are still queued then complete with set_stopped without
+// running, and running ones can poll stdexx::stop_requested().
+// The operation only completes once every child has, so none of them
+// outlives the operation state.
+// If no child produces a value, the first error is forwarded, or
+// set_stopped if all children were stopped.
+template <typename Receiver, typename... Senders>
+struct when_any_operation_state :
+  qt_os_base<when_any_operation_state<Receiver, Senders...>, Receiver> {
+  using base_t =
+    qt_os_base<when_any_operation_state<Receiver, Senders...>, Receiver>;
+  using receiver_t = qthreads_when_any_receiver<when_any_operation_state>;
+  using value_t = qt_value_tuple_t<
+    std::tuple_element_t<0, std::tuple<Senders...>>,
+    qthreads_when_all_env>;
+
+  static_assert(
+    (std::is_same_v<qt_value_tuple_t<Senders, qthreads_when_all_env>,
+                    value_t> &&
+     ...),
+    "All the children of when_any must send the same value types.");
+
+  enum : int { no_error = 0, failed_code, failed_exception };
+
+  // Forwards a stop request on the receiver of the when_any
+  // to all of its children.
+  struct forward_stop {
+    stdexec::inplace_stop_source *source;
+
+    void operator()() const noexcept { source->request_stop(); }
+  };
+
+  using parent_stop_callback_t =
+    stdexec::stop_callback_for_t<typename base_t::stop_token_t, forward_stop>;
+
+  qt_sinc_t sinc;
+  std::atomic<bool> won{false};
+  std::atomic<int> error_state{no_error};
+  std::optional<value_t> value{};
+  int error_code{0};
+  std::exception_ptr error{};
+  stdexec::inplace_stop_source stop_source{};
+  std::optional<parent_stop_callback_t> on_parent_stop{};
+  std::tuple<stdexec::connect_result_t<Senders, receiver_t>...> children;
+
+  template <typename Receiver_>
+  when_any_operation_state(std::tuple<Senders...> &&sndrs, Receiver_ &&r):
+    when_any_operation_state(std::move(sndrs),
+                             std::forward<Receiver_>(r),
+                             std::index_sequence_for<Senders...>{}) {}
+
+  template <typename Receiver_, std::size_t... Is>
+  when_any_operation_state(std::tuple<Senders...> &&sndrs,
+                           Receiver_ &&r,
+                           std::index_sequence<Is...>):
+    base_t(std::forward<Receiver_>(r)),
+    children(qt_emplace_from{[&] {
+      return stdexec::connect(std::move(std::get<Is>(sndrs)), receiver_t{this});
+    }}...) {
+    qt_sinc_init(&sinc, 0, NULL, NULL, sizeof...(Senders));
+  }
+
+  ~when_any_operation_state() { qt_sinc_fini(&sinc); }
+
+  template <class... As>
+  void set_child_value(As &&...as) noexcept {
+    if (!won.exchange(true)) {
+      stop_source.request_stop();
+      try {
+        value.emplace(static_cast<As &&>(as)...);
+      } catch (...) {
+        set_child_error(std::current_exception());
+        return;
+      }
+    }
+    qt_sinc_submit(&sinc, NULL);
+  }
+
+  template <class E>
+  void set_child_error(E &&e) noexcept {
+    int expected = no_error;
+    if constexpr (std::is_same_v<std::decay_t<E>, int>) {
+      if (error_state.compare_exchange_strong(expected, failed_code)) {
+        error_code = e;
+      }
+    } else {
+      if (error_state.compare_exchange_strong(expected, failed_exception)) {
+        if constexpr (std::is_same_v<std::decay_t<E>, std::exception_ptr>) {
+          error = static_cast<E &&>(e);
+        } else {
+          error = std::make_exception_ptr(static_cast<E &&>(e));
+        }
+      }
+    }
+    qt_sinc_submit(&sinc, NULL);
+  }
+
+  void set_child_stopped() noexcept { qt_sinc_submit(&sinc, NULL); }
+
+  static aligned_t task(void *os_void) noexcept {
+    auto *os = static_cast<when_any_operation_state *>(os_void);
+    if constexpr (!stdexec::unstoppable_token<typename base_t::stop_token_t>) {
+      os->on_parent_stop.emplace(
+        stdexec::get_stop_token(stdexec::get_env(os->receiver)),
+        forward_stop{&os->stop_source});
+    }
+    std::apply([](auto &...child) { (stdexec::start(child), ...); },
+               os->children);
+    qt_sinc_wait(&os->sinc, NULL);
+    os->on_parent_stop.reset();
+    os->complete();
+    return 0u;
+  }
+private:
+  void complete() noexcept {
+    if (value) {
+      std::apply(
+        [this](auto &&...vals) {
+          this->complete_value(static_cast<decltype(vals) &&>(vals)...);
+        },
+        std::move(*value));
+      return;
+    }
+    switch (error_state.load()) {
+      case failed_code: this->complete_error(error_code); break;
+      case failed_exception: this->complete_error(std::move(error)); break;
+      default: this->complete_stopped(); break;
+    }
+  }
+};
+
+template <typename... Senders>
+struct qthreads_when_any_sender :
+  qthreads_base_sender<qthreads_when_any_sender<Senders...>> {
+  std::tuple<Senders...> sndrs;
+
+  using value_t = typename qt_set_value_sig<qt_value_tuple_t<
+    std::tuple_element_t<0, std::tuple<Senders...>>,
+    qthreads_when_all_env>>::type;
+
+  using completion_signatures =
+    stdexec::completion_signatures<value_t,
+                                   stdexec::set_error_t(int),
+                                   stdexec::set_error_t(std::exception_ptr),
+                                   stdexec::set_stopped_t()>;
+
+  template <stdexec::receiver R>
+  auto connect(R r) && -> when_any_operation_state<R, Senders...> {
+    return {std::move(sndrs), static_cast<R &&>(r)};
+  }
+};
+
+// Races the given qthreads senders against each other.
+// Completes with the value of whichever child finishes first and
+// requests stop on the others, e.g. for hedged requests.
+template <typename... Senders>
+  requires(sizeof...(Senders) > 0 &&
+           (is_qthreads_sender<std::remove_cvref_t<Senders>> && ...))
+auto when_any(Senders &&...sndrs)
+  -> qthreads_when_any_sender<std::remove_cvref_t<Senders>...> {
+  return {{}, {static_cast<Senders &&>(sndrs)...}};
+}
+
+} // namespace stdexx
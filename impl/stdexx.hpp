@@ -3,8 +3,23 @@
 #if (STDEXX_QTHREADS)
 // ULT backend
 #include <qthreads/algorithms.hpp>
+#include <qthreads/bulk_chunked.hpp>
+#include <qthreads/counting_scope.hpp>
+#include <qthreads/feb.hpp>
+#include <qthreads/fused_bulk.hpp>
+#include <qthreads/graph.hpp>
+#include <qthreads/reduce.hpp>
+#include <qthreads/runtime.hpp>
+#include <qthreads/split.hpp>
 #include <qthreads/stdexec.hpp>
 #include <qthreads/stdexec_v2.hpp>
+#include <qthreads/timer.hpp>
+#include <qthreads/when_all_range.hpp>
+#include <qthreads/when_any.hpp>
+#elif (STDEXX_ARGOBOTS)
+// ULT backend
+#include <argobots/algorithms.hpp>
+#include <argobots/stdexec.hpp>
 #elif (STDEXX_REFERENCE)
 // stdexec backend
 #include <reference/algorithms.hpp>
@@ -1,5 +1,5 @@
-find_library(argobots_lib_found libabt PATHS ${ARGOBOTS_ROOT} SUFFIXES lib lib64 NO_DEFAULT_PATHS)
-find_path(argobots_headers_found abt.h PATHS ${ARGOBOTS_ROOT}/include NO_DEFAULT_PATHS)
+find_library(argobots_lib_found NAMES abt PATHS ${ARGOBOTS_ROOT} PATH_SUFFIXES lib lib64)
+find_path(argobots_headers_found abt.h PATHS ${ARGOBOTS_ROOT} PATH_SUFFIXES include)
 
 find_package_handle_standard_args(Argobots DEFAULT_MSG argobots_lib_found argobots_headers_found)
 